@@ -2,7 +2,7 @@ function(spore_codegen SPORE_TARGET_NAME)
   cmake_parse_arguments(
     "SPORE_CODEGEN"
     "FORCE;DEBUG;REFORMAT;"
-    "CONFIG;CACHE;TARGET_NAME;BIN_NAME;WORKING_DIRECTORY;"
+    "CONFIG;CACHE;JOBS;TARGET_NAME;BIN_NAME;WORKING_DIRECTORY;"
     "USER_DATA;TEMPLATES;ADDITIONAL_ARGS"
     ${ARGN}
   )
@@ -60,6 +60,7 @@ function(spore_codegen SPORE_TARGET_NAME)
       ${SPORE_CODEGEN_BIN_NAME}
       "$<$<BOOL:${SPORE_CODEGEN_CONFIG}>:--config;${SPORE_CODEGEN_CONFIG};>"
       "$<$<BOOL:${SPORE_CODEGEN_CACHE}>:--cache;${SPORE_CODEGEN_CACHE};>"
+      "$<$<BOOL:${SPORE_CODEGEN_JOBS}>:--jobs;${SPORE_CODEGEN_JOBS};>"
       "$<$<BOOL:${SPORE_CODEGEN_REFORMAT}>:--reformat;>"
       "$<$<BOOL:${SPORE_CODEGEN_FORCE}>:--force;>"
       "$<$<BOOL:${SPORE_CODEGEN_DEBUG}>:--debug;>"
@@ -1,10 +1,20 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "spore/codegen/codegen_artifact_cache.hpp"
 #include "spore/codegen/codegen_cache.hpp"
 #include "spore/codegen/codegen_config.hpp"
 #include "spore/codegen/codegen_data.hpp"
@@ -13,8 +23,16 @@
 #include "spore/codegen/codegen_macros.hpp"
 #include "spore/codegen/codegen_options.hpp"
 #include "spore/codegen/codegen_version.hpp"
+#include "spore/codegen/formatters/codegen_formatter.hpp"
 #include "spore/codegen/misc/current_path_scope.hpp"
 #include "spore/codegen/misc/defer.hpp"
+#include "spore/codegen/misc/file_writer.hpp"
+#include "spore/codegen/misc/make_unique_id.hpp"
+#include "spore/codegen/misc/mapped_file.hpp"
+#include "spore/codegen/misc/task_graph.hpp"
+#include "spore/codegen/misc/task_group.hpp"
+#include "spore/codegen/misc/thread_pool.hpp"
+#include "spore/codegen/renderers/codegen_renderer.hpp"
 #include "spore/codegen/utils/aggregates.hpp"
 #include "spore/codegen/utils/files.hpp"
 #include "spore/codegen/utils/strings.hpp"
@@ -41,6 +59,31 @@ namespace spore::codegen
             defer defer = finally;
             func();
         }
+
+        struct written_output
+        {
+            std::string path;
+            std::string key;
+            std::string hash;
+        };
+
+        // Outputs queued on the writer by the render tasks of a stage, recorded in the cache only once every write
+        // completed, so that an output that failed to be written is never considered up-to-date.
+        struct written_outputs
+        {
+            std::mutex mutex;
+            std::vector<written_output> outputs;
+
+            void add(std::string path, std::string key, std::string hash)
+            {
+                std::scoped_lock lock {mutex};
+                outputs.push_back({
+                    .path = std::move(path),
+                    .key = std::move(key),
+                    .hash = std::move(hash),
+                });
+            }
+        };
     }
 
     template <typename renderer_t, typename formatter_t, typename... impls_t>
@@ -49,16 +92,30 @@ namespace spore::codegen
         codegen_options options;
         codegen_config config;
         codegen_cache cache;
+        std::unordered_map<std::string, codegen_cache_status> cache_statuses;
+        codegen_artifact_cache artifact_cache;
+        codegen_artifact_cache input_cache;
         nlohmann::json user_data;
+        std::string user_data_hash;
         renderer_t renderer;
         formatter_t formatter;
         std::tuple<impls_t...> impls;
+        thread_pool pool;
+        file_writer writer;
+        std::vector<std::unique_ptr<codegen_renderer>> worker_renderers;
+        std::vector<std::unique_ptr<codegen_formatter>> worker_formatters;
+        std::mutex cache_mutex;
+        std::mutex glob_mutex;
+        std::mutex journal_mutex;
+        std::vector<bool> completed_stages;
+        std::vector<std::optional<std::vector<std::string>>> stage_claims;
 
         codegen_app(codegen_options in_options, renderer_t in_renderer, formatter_t in_formatter, impls_t... in_impls)
             : options(std::move(in_options)),
               renderer(std::move(in_renderer)),
               formatter(std::move(in_formatter)),
-              impls(std::move(in_impls)...)
+              impls(std::move(in_impls)...),
+              pool(options.jobs)
         {
             const auto normalize_path = [](std::string& value, const std::string* base = nullptr) {
                 std::filesystem::path path(value);
@@ -81,7 +138,6 @@ namespace spore::codegen
             normalize_path(options.cache);
 
             nlohmann::json config_json;
-            nlohmann::json cache_json;
 
             if (!files::read_file(options.config, config_json))
             {
@@ -90,22 +146,20 @@ namespace spore::codegen
 
             config = config_json;
 
-            if (!options.force && files::read_file(options.cache, cache_json))
-            {
-                cache = cache_json;
+            cache.reset(options.hash);
 
+            if (!options.force && cache.read(options.cache))
+            {
                 if (cache.version != SPORE_CODEGEN_VERSION)
                 {
                     SPDLOG_INFO("ignoring old cache, file={} version={}", options.cache, cache.version);
-                    cache.reset();
+                    cache.reset(options.hash);
+                }
+                else if (cache.algorithm != options.hash)
+                {
+                    SPDLOG_INFO("ignoring old cache because of new hash algorithm, file={} algorithm={}", options.cache, hashes::to_string(cache.algorithm));
+                    cache.reset(options.hash);
                 }
-            }
-
-            if (cache.check_and_update(options.config) == codegen_cache_status::dirty)
-            {
-                SPDLOG_INFO("ignoring old cache because of new config, file={} config={}", options.cache, options.config);
-                cache.reset();
-                std::ignore = cache.check_and_update(options.config);
             }
 
             user_data = nlohmann::json::object();
@@ -115,51 +169,63 @@ namespace spore::codegen
                 user_data[key] = value;
             }
 
+            user_data_hash = hashes::hash(cache.algorithm, user_data.dump());
+
+            // Parser results of every input are kept next to the cache, so that inputs rendered again only because
+            // of their templates or steps are not parsed again.
+            input_cache = codegen_artifact_cache {options.cache + ".inputs", cache.algorithm};
+
+            if (!options.artifact_cache.empty())
+            {
+                normalize_path(options.artifact_cache);
+                artifact_cache = codegen_artifact_cache {options.artifact_cache, cache.algorithm};
+            }
+
+            for (std::string& template_ : options.templates)
+            {
+                normalize_path(template_);
+            }
+
             options.templates.emplace_back(std::filesystem::current_path().string());
+
+            aggregates::for_each(impls, [&](auto& impl) { impl.parser().share_pool(pool); });
+
+            // Slot 0 is the calling thread and uses the main instances, every other slot gets its own copy.
+            for (std::size_t slot = 1; slot < pool.size(); ++slot)
+            {
+                worker_renderers.emplace_back(renderer.clone());
+                worker_formatters.emplace_back(formatter.clone());
+            }
         }
 
         void run()
         {
             const auto action = [&] {
                 codegen_data data = make_data();
+                task_graph graph;
+
+                completed_stages.assign(config.stages.size(), false);
+                stage_claims.assign(config.stages.size(), std::nullopt);
 
                 for (std::size_t index = 0; index < config.stages.size(); ++index)
                 {
-                    const codegen_config_stage& stage = config.stages.at(index);
-                    const std::filesystem::path stage_directory {stage.directory};
-
-                    if (!std::filesystem::exists(stage_directory))
-                    {
-                        SPDLOG_DEBUG("skipping stage because directory does not exist, stage={} directory={}", stage.name, stage.directory);
-                        continue;
-                    }
-
-                    codegen_stage_data& stage_data = data.stages[index].get();
-
-                    bool has_stage_run = false;
-                    const auto action_impl = [&]<typename impl_t>(const impl_t& impl) {
-                        if (stage.parser == impl_t::name())
-                        {
-                            if (has_stage_run)
-                            {
-                                SPDLOG_WARN("duplicate parser implementation, parser={}", stage.parser);
-                                return;
-                            }
-
-                            run_stage(impl, stage, data, stage_data);
-                            has_stage_run = true;
-                        }
-                    };
-
-                    aggregates::for_each(impls, action_impl);
+                    graph.add_task([&, index] {
+                        run_stage(index, data);
+                        flush_cache(index, data);
+                    });
+                }
 
-                    if (!has_stage_run)
+                for (std::size_t index = 0; index < config.stages.size(); ++index)
+                {
+                    for (const std::size_t dependency_index : get_stage_dependencies(index))
                     {
-                        SPDLOG_WARN("unknown parser implementation, parser={}", stage.parser);
+                        graph.add_dependency(index, dependency_index);
                     }
                 }
 
-                if (!files::write_file(options.cache, cache))
+                graph.run(pool);
+
+                if (!cache.save(options.cache))
                 {
                     SPDLOG_WARN("failed to write cache, file={}", options.cache);
                 }
@@ -172,270 +238,1366 @@ namespace spore::codegen
             detail::run_timed(action, finally);
         }
 
-        template <typename ast_t>
-        void run_stage(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage, const codegen_data& data, codegen_stage_data& stage_data)
+        std::vector<std::size_t> get_stage_dependencies(const std::size_t index) const
         {
-            current_path_scope directory_scope {stage.directory};
-
-            std::vector<std::size_t> dirty_indices;
-            dirty_indices.reserve(stage_data.files.size());
-
-            std::vector<std::string> dirty_files;
-            dirty_files.reserve(stage_data.files.size());
+            const codegen_config_stage& stage = config.stages.at(index);
 
-            const auto template_predicate = [](const codegen_template_data& template_data) {
-                return template_data.status != codegen_cache_status::up_to_date;
-            };
+            // Stages without explicit dependencies keep running after the previous stage, as they always did.
+            if (!stage.dependencies.has_value())
+            {
+                return index > 0 ? std::vector<std::size_t> {index - 1} : std::vector<std::size_t> {};
+            }
 
-            const bool has_dirty_templates = std::ranges::any_of(data.templates, template_predicate);
+            std::vector<std::size_t> dependency_indices;
+            dependency_indices.reserve(stage.dependencies->size());
 
-            for (std::size_t file_index = 0; file_index < stage_data.files.size(); ++file_index)
+            for (const std::string& dependency : stage.dependencies.value())
             {
-                const codegen_file_data& file_data = stage_data.files.at(file_index);
+                const auto stage_predicate = [&](const codegen_config_stage& other_stage) {
+                    return other_stage.name == dependency;
+                };
 
-                if (has_dirty_templates || file_data.status != codegen_cache_status::up_to_date)
+                const auto it_stage = std::ranges::find_if(config.stages, stage_predicate);
+                if (it_stage == config.stages.end())
                 {
-                    dirty_indices.emplace_back(file_index);
-                    dirty_files.emplace_back(file_data.path);
+                    throw codegen_error(codegen_error_code::configuring, "unknown stage dependency, stage={} dependency={}", stage.name, dependency);
                 }
+
+                dependency_indices.emplace_back(static_cast<std::size_t>(it_stage - config.stages.begin()));
             }
 
-            if (dirty_indices.empty())
+            return dependency_indices;
+        }
+
+        void run_stage(const std::size_t index, codegen_data& data)
+        {
+            const codegen_config_stage& stage = config.stages.at(index);
+            const std::filesystem::path stage_directory {stage.directory};
+
+            if (!std::filesystem::exists(stage_directory))
             {
-                SPDLOG_INFO("skipping stage, all files are up-to-date, stage={}", stage.name);
+                SPDLOG_DEBUG("skipping stage because directory does not exist, stage={} directory={}", stage.name, stage.directory);
                 return;
             }
 
-            std::vector<ast_t> asts;
-            parse_asts(impl, stage, dirty_files, asts);
-            erase_unmatched_outputs(impl, asts, dirty_indices, stage_data);
+            codegen_stage_data& stage_data = data.stages[index].get();
 
-            const auto action = [&] {
-                SPDLOG_DEBUG("rendering stage files, stage={} files={}", stage.name, stage.files);
-                for (std::size_t file_index = 0; file_index < dirty_files.size(); ++file_index)
+            bool has_stage_run = false;
+            const auto action_impl = [&]<typename impl_t>(const impl_t& impl) {
+                if (stage.parser == impl_t::name())
                 {
-                    const ast_t& ast = asts.at(file_index);
-                    const codegen_file_data& file_data = stage_data.files.at(dirty_indices.at(file_index));
-
-                    if (!file_data.outputs.empty())
+                    if (has_stage_run)
                     {
-                        render_ast(impl, data, stage_data, file_data, ast);
+                        SPDLOG_WARN("duplicate parser implementation, parser={}", stage.parser);
+                        return;
                     }
+
+                    run_stage(impl, stage, data, stage_data);
+                    has_stage_run = true;
                 }
             };
 
-            const auto finally = [&](std::float_t duration) {
-                SPDLOG_INFO("rendering completed, stage={} duration={:.3f}s", stage.name, duration);
-            };
+            aggregates::for_each(impls, action_impl);
 
-            detail::run_timed(action, finally);
+            if (!has_stage_run)
+            {
+                SPDLOG_WARN("unknown parser implementation, parser={}", stage.parser);
+                return;
+            }
+
+            std::scoped_lock lock {cache_mutex};
+            cache.update_fingerprint(stage.name, stage_data.hash);
+
+            for (std::size_t step_index = 0; step_index < stage_data.steps.size(); ++step_index)
+            {
+                cache.update_fingerprint(get_step_fingerprint_name(stage, step_index), stage_data.steps.at(step_index).hash);
+            }
         }
 
-        template <typename ast_t>
-        void parse_asts(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage, const std::vector<std::string>& files, std::vector<ast_t>& asts) const
+        static std::string get_step_fingerprint_name(const codegen_config_stage& stage, const std::size_t step_index)
         {
-            const auto action = [&] {
-                SPDLOG_INFO("parsing stage files, stage={} parser={} files={} count={}", stage.name, stage.parser, stage.files, files.size());
+            return std::format("{}/{}", stage.name, step_index);
+        }
+
+        // Entries are journaled once every stage reading their file completed, so that an interrupted run never
+        // records a file as up-to-date for a stage that did not process it.
+        void flush_cache(const std::size_t index, const codegen_data& data)
+        {
+            std::scoped_lock journal_lock {journal_mutex};
+            completed_stages.at(index) = true;
+
+            std::unordered_set<std::string> claimed_files;
 
-                if (!impl.parser().parse_asts(files, asts))
+            for (std::size_t stage_index = 0; stage_index < config.stages.size(); ++stage_index)
+            {
+                if (completed_stages.at(stage_index))
                 {
-                    throw codegen_error(codegen_error_code::parsing, "failed to parse stage input files, stage={} parser={} files={}", stage.name, stage.parser, stage.files);
+                    continue;
                 }
-            };
 
-            const auto finally = [&](std::float_t duration) {
-                SPDLOG_INFO("parsing completed, stage={} duration={:.3f}s", stage.name, duration);
-            };
+                std::optional<std::vector<std::string>>& claims = stage_claims.at(stage_index);
 
-            detail::run_timed(action, finally);
-        }
+                if (!claims.has_value())
+                {
+                    claims = find_stage_claims(stage_index, data);
+                }
 
-        template <typename ast_t>
-        void render_ast(const codegen_impl<ast_t>& impl, const codegen_data& data, const codegen_stage_data& stage_data, const codegen_file_data& file_data, const ast_t& ast)
-        {
-            nlohmann::json json_data;
-            if (!impl.converter().convert_ast(ast, json_data))
-            {
-                throw codegen_error(codegen_error_code::rendering, "failed to convert input data to json, file={}", file_data.path);
+                claimed_files.insert(claims->begin(), claims->end());
             }
 
-            json_data["$"] = {
-                {"stage", stage_data},
-                {"file", file_data},
-                {"user_data", user_data},
+            const auto flush_predicate = [&](const std::string& file) {
+                return !claimed_files.contains(file);
             };
 
-            for (const codegen_step_data& step_data : stage_data.steps)
-            {
-                json_data["$"]["step"] = step_data;
+            std::scoped_lock lock {cache_mutex};
 
-                for (std::size_t template_index : step_data.template_indices)
-                {
-                    const codegen_template_data& template_data = data.templates.at(template_index);
+            if (!cache.flush(options.cache, flush_predicate))
+            {
+                SPDLOG_WARN("failed to flush cache, file={}", options.cache);
+            }
+        }
 
-                    const auto output_predicate = [&](const codegen_output_data& output_data) {
-                        return output_data.template_index == template_index;
-                    };
+        // Files a stage reads, found from its patterns rather than from its data, which is only made when it runs.
+        std::vector<std::string> find_stage_claims(const std::size_t index, const codegen_data& data)
+        {
+            const codegen_config_stage& stage = config.stages.at(index);
+            std::vector<std::string> claims;
 
-                    const auto it_output = std::ranges::find_if(file_data.outputs, output_predicate);
-                    if (it_output == file_data.outputs.end())
-                    {
-                        SPDLOG_DEBUG("template skipped, no output, file={} template={}", file_data.path, template_data.path);
-                        continue;
-                    }
+            if (!std::filesystem::exists(std::filesystem::path {stage.directory}))
+            {
+                return claims;
+            }
 
-                    const codegen_output_data& output_data = *it_output;
+            {
+                current_path_scope directory_scope {stage.directory};
 
-                    json_data["$"]["template"] = template_data;
-                    json_data["$"]["output"] = output_data;
+                for (const std::filesystem::path& stage_file : find_stage_files(stage))
+                {
+                    claims.emplace_back(current_path_scope::absolute(stage_file).string());
+                }
+            }
 
-                    SPDLOG_DEBUG("rendering output, file={}", output_data.path);
+            {
+                std::scoped_lock lock {cache_mutex};
+                const std::size_t file_count = claims.size();
 
-                    std::string result;
-                    if (!renderer.render_file(template_data.path, json_data, result))
+                for (std::size_t file_index = 0; file_index < file_count; ++file_index)
+                {
+                    if (std::optional<codegen_cache_entry> entry = cache.find(claims.at(file_index)))
                     {
-                        throw codegen_error(codegen_error_code::rendering, "failed to render input, file={} template={}", file_data.path, template_data.path);
+                        claims.insert(claims.end(), entry->dependencies.begin(), entry->dependencies.end());
                     }
+                }
+            }
 
-                    if (options.reformat)
+            for (const codegen_config_step& step : stage.steps)
+            {
+                for (const std::string& template_ : step.templates)
+                {
+                    const auto it_template_index = data.template_indices.find(template_);
+                    if (it_template_index != data.template_indices.end())
                     {
-                        SPDLOG_DEBUG("reformatting output, file={}", output_data.path);
-
-                        if (!formatter.format_file(output_data.path, result))
+                        for (const std::size_t closure_index : get_template_closure(data, it_template_index->second))
                         {
-                            SPDLOG_DEBUG("failed to reformat output, file={}", output_data.path);
+                            claims.emplace_back(data.templates.at(closure_index).path);
                         }
                     }
-
-                    SPDLOG_DEBUG("writing output, file={}", output_data.path);
-
-                    if (!files::write_file(output_data.path, result))
-                    {
-                        throw codegen_error(codegen_error_code::io, "failed to write output, file={}", output_data.path);
-                    }
                 }
             }
+
+            return claims;
         }
 
         template <typename ast_t>
-        static void erase_unmatched_outputs(const codegen_impl<ast_t>& impl, const std::vector<ast_t>& asts, const std::vector<std::size_t>& file_indices, codegen_stage_data& stage_data)
+        void run_stage(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage, const codegen_data& data, codegen_stage_data& stage_data)
         {
-            for (std::size_t step_index = 0; step_index < stage_data.steps.size(); ++step_index)
+            current_path_scope directory_scope {stage.directory};
+            const std::filesystem::path stage_directory = current_path_scope::current_path();
+
+            stage_data.hash = make_stage_hash(impl, stage);
+
+            bool is_stage_dirty;
+
             {
-                const codegen_step_data& step_data = stage_data.steps.at(step_index);
+                std::scoped_lock lock {cache_mutex};
+                const std::optional<std::string> stage_hash = cache.find_fingerprint(stage.name);
+                is_stage_dirty = stage_hash != stage_data.hash;
 
-                std::shared_ptr<codegen_condition<ast_t>> step_condition;
-                if (step_data.condition.has_value())
+                if (is_stage_dirty && stage_hash.has_value())
                 {
-                    step_condition = impl.condition(step_data.condition.value());
+                    SPDLOG_INFO("stage config changed, stage={}", stage.name);
                 }
+            }
 
-                for (std::size_t file_index = 0; file_index < file_indices.size(); ++file_index)
-                {
-                    const ast_t& ast = asts.at(file_index);
-                    const bool ast_matches = step_condition == nullptr || step_condition->match_ast(ast);
+            // Outputs deleted or modified since they were written are rendered again, along with the other outputs of
+            // their input.
+            const std::unordered_set<std::string> modified_outputs = is_stage_dirty ? std::unordered_set<std::string> {} : find_modified_outputs(stage_data);
 
-                    if (!ast_matches)
-                    {
-                        codegen_file_data& file_data = stage_data.files.at(file_indices.at(file_index));
-                        const auto output_predicate = [&](const codegen_output_data& output_data) {
-                            return output_data.step_index == step_index;
-                        };
+            std::vector<std::size_t> dirty_indices;
+            dirty_indices.reserve(stage_data.files.size());
 
-                        std::erase_if(file_data.outputs, output_predicate);
-                    }
-                }
-            }
-        }
+            std::vector<std::string> dirty_files;
+            dirty_files.reserve(stage_data.files.size());
 
-        codegen_data make_data()
-        {
-            codegen_data data;
-            data.stages.reserve(config.stages.size());
+            // Files that did not change are only rendered again with the templates and steps that did, templates and
+            // steps of other outputs do not affect them.
+            std::vector<bool> dirty_outputs_only(stage_data.files.size());
 
-            for (std::string& template_ : options.templates)
+            const auto output_predicate = [&](const codegen_output_data& output_data) {
+                return is_output_dirty(data, stage_data, output_data);
+            };
+
+            for (std::size_t file_index = 0; file_index < stage_data.files.size(); ++file_index)
             {
-                std::filesystem::path pattern = std::filesystem::path(template_) / "**" / "*";
-                std::vector<std::filesystem::path> template_files = glob::rglob(pattern.string());
+                const codegen_file_data& file_data = stage_data.files.at(file_index);
 
-                for (const std::filesystem::path& template_file : template_files)
-                {
-                    std::string template_string = template_file.string();
-                    if (renderer.can_render_file(template_string))
-                    {
-                        const codegen_cache_status status = cache.check_and_update(template_string);
+                const auto modified_predicate = [&](const codegen_output_data& output_data) {
+                    return modified_outputs.contains(output_data.path);
+                };
 
-                        codegen_template_data template_data {
-                            .path = std::move(template_string),
-                            .status = status,
-                        };
+                const bool is_file_dirty = is_stage_dirty || file_data.status != codegen_cache_status::up_to_date || std::ranges::any_of(file_data.outputs, modified_predicate);
 
-                        data.templates.emplace_back(std::move(template_data));
-                    }
+                if (is_file_dirty || std::ranges::any_of(file_data.outputs, output_predicate))
+                {
+                    dirty_indices.emplace_back(file_index);
+                    dirty_files.emplace_back(file_data.path);
+                    dirty_outputs_only.at(file_index) = !is_file_dirty;
                 }
             }
 
-            for (const codegen_config_stage& stage : config.stages)
+            if (dirty_indices.empty())
             {
-                auto stage_func = [&] { return make_stage_data(stage, data); };
-                data.stages.emplace_back(std::move(stage_func));
+                SPDLOG_INFO("skipping stage, all files are up-to-date, stage={}", stage.name);
+                return;
             }
 
-            return data;
-        }
+            const std::vector<std::shared_ptr<codegen_condition<ast_t>>> step_conditions = make_step_conditions(impl, stage_data);
 
-        codegen_stage_data make_stage_data(const codegen_config_stage& stage, const codegen_data& data)
-        {
-            codegen_stage_data stage_data;
+            // Every file is rendered with the whole stage in its context, including outputs of other files. When
+            // outputs are erased by step conditions, rendering waits until every file is parsed, so that each file
+            // sees the same context.
+            const bool has_step_conditions = std::ranges::any_of(step_conditions, [](const auto& condition) { return condition != nullptr; });
 
-            {
-                current_path_scope directory_scope {stage.directory};
+            // Every file left is rendered, whether it is parsed or found in the artifact cache.
+            const std::vector<std::size_t> rendered_indices = dirty_indices;
 
-                std::vector<std::filesystem::path> stage_files = glob::rglob(stage.files);
-                stage_data.files.reserve(stage_files.size());
+            // Files whose parser results are found in the input cache or in the artifact cache are not parsed.
+            std::vector<std::pair<std::size_t, nlohmann::json>> artifact_json_data = load_input_artifacts(impl, stage, stage_data, dirty_indices, dirty_files);
 
-                for (const std::filesystem::path& stage_file : stage_files)
-                {
-                    std::string file_string = stage_file.string();
-                    const codegen_cache_status status = cache.check_and_update(file_string);
+            // Files without any marker of the stage are converted as empty files instead of being parsed, they are moved
+            // before the files to parse.
+            const std::size_t unmarked_count = partition_unmarked_files(stage, dirty_indices, dirty_files);
 
-                    codegen_file_data file_data {
-                        .path = std::move(file_string),
-                        .status = status,
+            std::vector<std::pair<std::size_t, nlohmann::json>> pending_json_data;
+            std::vector<std::vector<std::string>> dirty_dependencies(dirty_files.size());
+            std::vector<std::optional<codegen_input_artifact>> dirty_artifacts(dirty_files.size());
+
+            // The stage context is serialized once per thread rather than once per file, then moved in and out of the
+            // data of each file it renders, so that its cost does not grow with the number of files rendered.
+            std::vector<nlohmann::json> stage_contexts(pool.size());
+            std::size_t parsed_count = 0;
+
+            const auto action = [&] {
+                SPDLOG_DEBUG("rendering stage files, stage={} files={} jobs={}", stage.name, stage.files, pool.size());
+
+                // Outputs are written while rendering continues, the render group is completed before the write group.
+                file_writer::group write_group {writer};
+                detail::written_outputs written_outputs;
+                task_group render_group {pool};
+
+                const auto render_action = [&](const std::size_t file_index, nlohmann::json&& json_data) {
+                    auto render_task = [&, file_index, json_data = std::move(json_data)]() mutable {
+                        current_path_scope file_directory_scope {stage_directory};
+                        nlohmann::json& stage_context = stage_contexts.at(thread_pool::current_slot());
+                        render_json(data, stage_data, stage_data.files.at(file_index), json_data, stage_context, dirty_outputs_only.at(file_index), write_group, written_outputs);
                     };
 
-                    stage_data.files.emplace_back(std::move(file_data));
+                    render_group.run(std::move(render_task));
+                };
+
+                const auto json_action = [&](const std::size_t file_index, nlohmann::json&& json_data) {
+                    if (has_step_conditions)
+                    {
+                        pending_json_data.emplace_back(file_index, std::move(json_data));
+                    }
+                    else
+                    {
+                        render_action(file_index, std::move(json_data));
+                    }
+                };
+
+                for (auto& [file_index, json_data] : artifact_json_data)
+                {
+                    json_action(file_index, std::move(json_data));
                 }
-            }
 
-            for (std::size_t step_index = 0; step_index < stage.steps.size(); ++step_index)
-            {
-                const codegen_config_step& step = stage.steps.at(step_index);
+                // Asts are converted in file order as they are parsed, so that generated ids are the same as with a
+                // single job, while rendering is spread over the pool.
+                const auto ast_callback = [&](ast_t&& ast) {
+                    const std::size_t dirty_index = parsed_count++;
+                    const std::size_t file_index = dirty_indices.at(dirty_index);
+                    codegen_file_data& file_data = stage_data.files.at(file_index);
 
-                codegen_step_data step_data {
-                    .condition = step.condition,
+                    if (has_step_conditions)
+                    {
+                        erase_unmatched_outputs(step_conditions, ast, file_data);
+                    }
+
+                    nlohmann::json json_data;
+
+                    if (!file_data.outputs.empty())
+                    {
+                        convert_ast(impl, file_index, file_data, ast, json_data);
+                    }
+
+                    dirty_artifacts.at(dirty_index) = make_input_artifact(file_data, json_data);
+
+                    if (!file_data.outputs.empty())
+                    {
+                        json_action(file_index, std::move(json_data));
+                    }
                 };
 
-                for (const std::string& template_ : step.templates)
+                const auto dependencies_callback = [&](const std::size_t path_index, std::vector<std::string>&& dependencies) {
+                    dirty_dependencies.at(unmarked_count + path_index) = std::move(dependencies);
+                };
+
+                for (std::size_t dirty_index = 0; dirty_index < unmarked_count; ++dirty_index)
                 {
-                    const std::string template_deterministic = std::filesystem::path(template_).make_preferred().string();
-                    const auto template_predicate = [&](const codegen_template_data& template_data) {
-                        // TODO @sporacid Find a better way to achieve the same thing without suffix matching
-                        return template_data.path.ends_with(template_deterministic);
-                    };
+                    ast_callback(impl.parser().make_empty_ast(dirty_files.at(dirty_index)));
+                }
 
-                    const auto it_template = std::ranges::find_if(data.templates, template_predicate);
-                    if (it_template != data.templates.end())
+                if (dirty_files.size() > unmarked_count)
+                {
+                    const std::vector<std::string> parse_files(dirty_files.begin() + static_cast<std::ptrdiff_t>(unmarked_count), dirty_files.end());
+                    parse_asts(impl, stage, parse_files, ast_callback, dependencies_callback);
+
+                    // Parsing may prepare state the fingerprint of the parser depends on, e.g. a precompiled preamble,
+                    // the stage is recorded with the fingerprint its files were parsed with.
+                    stage_data.hash = make_stage_hash(impl, stage);
+                }
+
+                if (!dirty_files.empty())
+                {
+                    store_input_artifacts(impl, stage, stage_data, dirty_indices, dirty_dependencies, dirty_artifacts);
+                    update_cache_dependencies(dirty_files, dirty_dependencies);
+                }
+
+                for (auto& [file_index, json_data] : pending_json_data)
+                {
+                    render_action(file_index, std::move(json_data));
+                }
+
+                render_group.wait();
+                write_group.wait();
+
+                update_cache_written_outputs(written_outputs);
+                update_cache_outputs(stage_data, rendered_indices);
+            };
+
+            const auto finally = [&](std::float_t duration) {
+                SPDLOG_INFO("rendering completed, stage={} duration={:.3f}s", stage.name, duration);
+            };
+
+            detail::run_timed(action, finally);
+        }
+
+        // Stages whose config or parser arguments changed are parsed and rendered again whole, other stages are not
+        // affected.
+        template <typename ast_t>
+        std::string make_stage_hash(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage)
+        {
+            const nlohmann::json stage_json {
+                {"directory", stage.directory},
+                {"parser", stage.parser},
+                {"files", stage.files},
+                {"markers", stage.markers},
+            };
+
+            return hashes::hash(cache.algorithm, stage_json.dump() + impl.parser().fingerprint());
+        }
+
+        template <typename ast_t>
+        std::string make_input_artifact_key(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage, const codegen_stage_data& stage_data, const std::size_t file_index)
+        {
+            const codegen_file_data& file_data = stage_data.files.at(file_index);
+
+            // Step conditions decide which outputs a file has, they are part of what is stored.
+            nlohmann::json conditions = nlohmann::json::array();
+
+            for (const codegen_step_data& step_data : stage_data.steps)
+            {
+                conditions.emplace_back(step_data.condition.value_or(nullptr));
+            }
+
+            std::string hash;
+
+            {
+                std::scoped_lock lock {cache_mutex};
+
+                if (const std::optional<codegen_cache_entry> entry = cache.find(current_path_scope::absolute(file_data.path).string()))
+                {
+                    hash = entry->hash;
+                }
+            }
+
+            // Ids of the converted data depend on the index of the file in its stage.
+            const nlohmann::json markers = stage.markers;
+            return artifact_cache.make_key({"input", SPORE_CODEGEN_VERSION, stage.parser, impl.parser().fingerprint(), file_data.path, std::to_string(file_index), hash, conditions.dump(), markers.dump()});
+        }
+
+        // Files are scanned on the pool, a file that cannot be read is parsed so that the parser reports it.
+        std::size_t partition_unmarked_files(const codegen_config_stage& stage, std::vector<std::size_t>& dirty_indices, std::vector<std::string>& dirty_files)
+        {
+            if (stage.markers.empty() || dirty_files.empty())
+            {
+                return 0;
+            }
+
+            const std::filesystem::path stage_directory = current_path_scope::current_path();
+            std::vector<bool> unmarked(dirty_files.size());
+
+            pool.parallel_for(dirty_files.size(), [&](const std::size_t index) {
+                current_path_scope file_directory_scope {stage_directory};
+                mapped_file file;
+
+                if (file.open(current_path_scope::absolute(dirty_files.at(index))))
+                {
+                    unmarked.at(index) = !strings::contains_any(file.text(), stage.markers);
+                }
+            });
+
+            std::vector<std::size_t> partitioned_indices;
+            std::vector<std::string> partitioned_files;
+            partitioned_indices.reserve(dirty_indices.size());
+            partitioned_files.reserve(dirty_files.size());
+
+            for (const bool is_unmarked : {true, false})
+            {
+                for (std::size_t index = 0; index < dirty_files.size(); ++index)
+                {
+                    if (unmarked.at(index) == is_unmarked)
+                    {
+                        partitioned_indices.emplace_back(dirty_indices.at(index));
+                        partitioned_files.emplace_back(std::move(dirty_files.at(index)));
+                    }
+                }
+            }
+
+            const auto unmarked_count = static_cast<std::size_t>(std::ranges::count(unmarked, true));
+
+            if (unmarked_count != 0)
+            {
+                SPDLOG_INFO("skipping files without markers, stage={} count={}", stage.name, unmarked_count);
+            }
+
+            dirty_indices = std::move(partitioned_indices);
+            dirty_files = std::move(partitioned_files);
+            return unmarked_count;
+        }
+
+        // Each input of a stage has a single slot in the input cache, its results replace those of its previous
+        // content, so that the input cache does not grow with every change.
+        std::string make_input_slot(const codegen_config_stage& stage, const codegen_file_data& file_data) const
+        {
+            return input_cache.make_key({"slot", stage.name, current_path_scope::absolute(file_data.path).string()});
+        }
+
+        static codegen_input_artifact make_input_artifact(const codegen_file_data& file_data, const nlohmann::json& json_data)
+        {
+            codegen_input_artifact artifact {
+                .data = json_data,
+            };
+
+            for (const codegen_output_data& output_data : file_data.outputs)
+            {
+                artifact.step_indices.emplace_back(output_data.step_index);
+            }
+
+            std::ranges::sort(artifact.step_indices);
+            artifact.step_indices.erase(std::ranges::unique(artifact.step_indices).begin(), artifact.step_indices.end());
+            return artifact;
+        }
+
+        // Artifacts are only used when every file they were parsed with is the same, files that are not found are
+        // removed from the files to parse. The input cache is looked up first, since it is local, forcing a run only
+        // skips the input cache.
+        template <typename ast_t>
+        std::vector<std::pair<std::size_t, nlohmann::json>> load_input_artifacts(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage, codegen_stage_data& stage_data, std::vector<std::size_t>& dirty_indices, std::vector<std::string>& dirty_files)
+        {
+            std::vector<std::pair<std::size_t, nlohmann::json>> json_data;
+
+            if (options.force && !artifact_cache.enabled())
+            {
+                return json_data;
+            }
+
+            const std::filesystem::path stage_directory = current_path_scope::current_path();
+            std::vector<std::optional<codegen_input_artifact>> artifacts(dirty_indices.size());
+
+            pool.parallel_for(dirty_indices.size(), [&](const std::size_t index) {
+                current_path_scope file_directory_scope {stage_directory};
+                const codegen_file_data& file_data = stage_data.files.at(dirty_indices.at(index));
+                const std::string key = make_input_artifact_key(impl, stage, stage_data, dirty_indices.at(index));
+
+                codegen_input_artifact artifact;
+                const bool is_found = (!options.force && input_cache.read(make_input_slot(stage, file_data), key, artifact)) || (artifact_cache.enabled() && artifact_cache.read(key, artifact));
+
+                if (is_found)
+                {
+                    artifacts.at(index) = std::move(artifact);
+                }
+            });
+
+            std::vector<std::string> dependencies;
+
+            for (const std::optional<codegen_input_artifact>& artifact : artifacts)
+            {
+                if (artifact.has_value())
+                {
+                    for (const codegen_artifact_dependency& dependency : artifact->dependencies)
+                    {
+                        dependencies.emplace_back(current_path_scope::absolute(dependency.path).string());
+                    }
+                }
+            }
+
+            std::ranges::sort(dependencies);
+            dependencies.erase(std::ranges::unique(dependencies).begin(), dependencies.end());
+            std::ignore = check_and_update_cache(dependencies);
+
+            std::vector<std::size_t> parse_indices;
+            std::vector<std::string> parse_files;
+            std::vector<std::string> loaded_files;
+            std::vector<std::vector<std::string>> loaded_dependencies;
+
+            for (std::size_t index = 0; index < dirty_indices.size(); ++index)
+            {
+                std::optional<codegen_input_artifact>& artifact = artifacts.at(index);
+                std::vector<std::string> artifact_dependencies;
+
+                if (artifact.has_value())
+                {
+                    std::scoped_lock lock {cache_mutex};
+
+                    for (const codegen_artifact_dependency& dependency : artifact->dependencies)
+                    {
+                        std::string dependency_path = current_path_scope::absolute(dependency.path).string();
+                        const std::optional<codegen_cache_entry> entry = cache.find(dependency_path);
+
+                        if (!entry.has_value() || entry->hash != dependency.hash)
+                        {
+                            artifact.reset();
+                            break;
+                        }
+
+                        artifact_dependencies.emplace_back(std::move(dependency_path));
+                    }
+                }
+
+                const std::size_t file_index = dirty_indices.at(index);
+                codegen_file_data& file_data = stage_data.files.at(file_index);
+
+                if (!artifact.has_value())
+                {
+                    parse_indices.emplace_back(file_index);
+                    parse_files.emplace_back(file_data.path);
+                    continue;
+                }
+
+                const auto output_predicate = [&](const codegen_output_data& output_data) {
+                    return !std::ranges::binary_search(artifact->step_indices, output_data.step_index);
+                };
+
+                std::erase_if(file_data.outputs, output_predicate);
+
+                if (!file_data.outputs.empty())
+                {
+                    json_data.emplace_back(file_index, std::move(artifact->data));
+                }
+
+                loaded_files.emplace_back(file_data.path);
+                loaded_dependencies.emplace_back(std::move(artifact_dependencies));
+            }
+
+            if (!loaded_files.empty())
+            {
+                SPDLOG_INFO("parser results found in cache, stage={} count={}", stage.name, loaded_files.size());
+            }
+
+            dirty_indices = std::move(parse_indices);
+            dirty_files = std::move(parse_files);
+            update_cache_dependencies(loaded_files, loaded_dependencies);
+
+            return json_data;
+        }
+
+        template <typename ast_t>
+        void store_input_artifacts(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage, const codegen_stage_data& stage_data, const std::vector<std::size_t>& dirty_indices, const std::vector<std::vector<std::string>>& dirty_dependencies, std::vector<std::optional<codegen_input_artifact>>& dirty_artifacts)
+        {
+            const std::filesystem::path stage_directory = current_path_scope::current_path();
+            std::ignore = check_and_update_cache(get_unique_dependencies(dirty_dependencies));
+
+            // Every parsed input is stored, artifacts are serialized and written on the pool.
+            pool.parallel_for(dirty_artifacts.size(), [&](const std::size_t index) {
+                current_path_scope file_directory_scope {stage_directory};
+                std::optional<codegen_input_artifact>& artifact = dirty_artifacts.at(index);
+
+                if (!artifact.has_value())
+                {
+                    return;
+                }
+
+                {
+                    std::scoped_lock lock {cache_mutex};
+
+                    for (const std::string& dependency : dirty_dependencies.at(index))
+                    {
+                        const std::optional<codegen_cache_entry> entry = cache.find(dependency);
+
+                        std::string relative_path = std::filesystem::path(dependency).lexically_relative(stage_directory).generic_string();
+
+                        codegen_artifact_dependency artifact_dependency {
+                            .path = relative_path.empty() ? dependency : std::move(relative_path),
+                            .hash = entry.has_value() ? entry->hash : std::string {},
+                        };
+
+                        artifact->dependencies.emplace_back(std::move(artifact_dependency));
+                    }
+                }
+
+                const codegen_file_data& file_data = stage_data.files.at(dirty_indices.at(index));
+                artifact->key = make_input_artifact_key(impl, stage, stage_data, dirty_indices.at(index));
+
+                if (!input_cache.write(make_input_slot(stage, file_data), artifact.value()))
+                {
+                    SPDLOG_DEBUG("failed to store parser results, file={}", file_data.path);
+                }
+
+                if (artifact_cache.enabled())
+                {
+                    std::ignore = artifact_cache.write(artifact->key, artifact.value());
+                }
+            });
+        }
+
+        template <typename ast_t>
+        void parse_asts(const codegen_impl<ast_t>& impl, const codegen_config_stage& stage, const std::vector<std::string>& files, const typename codegen_parser<ast_t>::ast_callback_t& callback, const typename codegen_parser<ast_t>::dependencies_callback_t& dependencies_callback) const
+        {
+            const auto action = [&] {
+                SPDLOG_INFO("parsing stage files, stage={} parser={} files={} count={}", stage.name, stage.parser, stage.files, files.size());
+
+                if (!impl.parser().parse_asts(files, callback, dependencies_callback))
+                {
+                    throw codegen_error(codegen_error_code::parsing, "failed to parse stage input files, stage={} parser={} files={}", stage.name, stage.parser, stage.files);
+                }
+            };
+
+            const auto finally = [&](std::float_t duration) {
+                SPDLOG_INFO("parsing completed, stage={} duration={:.3f}s", stage.name, duration);
+            };
+
+            detail::run_timed(action, finally);
+        }
+
+        template <typename ast_t>
+        static void convert_ast(const codegen_impl<ast_t>& impl, const std::size_t file_index, const codegen_file_data& file_data, const ast_t& ast, nlohmann::json& json_data)
+        {
+            // Ids made while converting only depend on the file and its index in the stage, so that converting the same
+            // file always gives the same data and no two files of a stage share ids.
+            unique_id_scope id_scope {file_index};
+
+            if (!impl.converter().convert_ast(ast, json_data))
+            {
+                throw codegen_error(codegen_error_code::rendering, "failed to convert input data to json, file={}", file_data.path);
+            }
+        }
+
+        static bool is_output_dirty(const codegen_data& data, const codegen_stage_data& stage_data, const codegen_output_data& output_data)
+        {
+            return data.templates.at(output_data.template_index).status != codegen_cache_status::up_to_date || stage_data.steps.at(output_data.step_index).status != codegen_cache_status::up_to_date;
+        }
+
+        void render_json(const codegen_data& data, const codegen_stage_data& stage_data, const codegen_file_data& file_data, nlohmann::json& json_data, nlohmann::json& stage_context, const bool dirty_outputs_only, file_writer::group& write_group, detail::written_outputs& written_outputs)
+        {
+            // Outputs are keyed on the converted data rather than on the input file, so that edits that do not change
+            // the data, e.g. of comments, do not render anything again.
+            const std::string data_hash = hashes::hash(cache.algorithm, json_data.dump());
+
+            if (stage_context.is_null())
+            {
+                stage_context = {
+                    {"stage", stage_data},
+                    {"user_data", user_data},
+                };
+            }
+
+            json_data["$"] = std::move(stage_context);
+
+            const auto restore_stage_context = [&] { stage_context = std::move(json_data["$"]); };
+            defer defer_restore_stage_context = restore_stage_context;
+
+            json_data["$"]["file"] = file_data;
+
+            for (const codegen_step_data& step_data : stage_data.steps)
+            {
+                json_data["$"]["step"] = step_data;
+
+                for (std::size_t template_index : step_data.template_indices)
+                {
+                    const codegen_template_data& template_data = data.templates.at(template_index);
+
+                    if (dirty_outputs_only && template_data.status == codegen_cache_status::up_to_date && step_data.status == codegen_cache_status::up_to_date)
+                    {
+                        SPDLOG_DEBUG("template skipped, up-to-date, file={} template={}", file_data.path, template_data.path);
+                        continue;
+                    }
+
+                    const auto output_predicate = [&](const codegen_output_data& output_data) {
+                        return output_data.template_index == template_index;
+                    };
+
+                    const auto it_output = std::ranges::find_if(file_data.outputs, output_predicate);
+                    if (it_output == file_data.outputs.end())
+                    {
+                        SPDLOG_DEBUG("template skipped, no output, file={} template={}", file_data.path, template_data.path);
+                        continue;
+                    }
+
+                    const codegen_output_data& output_data = *it_output;
+                    std::string output_key = hashes::hash(cache.algorithm, data_hash + template_data.hash + step_data.hash);
+
+                    if (is_output_up_to_date(output_data.path, output_key))
+                    {
+                        SPDLOG_DEBUG("output up-to-date, render skipped, file={}", output_data.path);
+                        continue;
+                    }
+
+                    // Outputs of other working copies are found under the same key, the path is relative to the stage.
+                    // Reformatted outputs also depend on the style they are formatted with, which is not part of the
+                    // working copy when it comes from a parent directory.
+                    std::string artifact_key;
+                    std::string result;
+
+                    if (artifact_cache.enabled())
+                    {
+                        const std::string relative_path = std::filesystem::path(output_data.path).lexically_relative(current_path_scope::current_path()).generic_string();
+                        const std::string format_fingerprint = options.reformat ? get_formatter().fingerprint(output_data.path) : std::string {};
+                        artifact_key = artifact_cache.make_key({"output", SPORE_CODEGEN_VERSION, output_key, relative_path, options.reformat ? "reformat" : "", format_fingerprint});
+
+                        if (artifact_cache.read(artifact_key, result))
+                        {
+                            SPDLOG_DEBUG("output found in artifact cache, render skipped, file={}", output_data.path);
+                            std::string output_hash = hashes::hash(cache.algorithm, result);
+                            write_group.write(output_data.path, std::move(result));
+                            written_outputs.add(output_data.path, std::move(output_key), std::move(output_hash));
+                            continue;
+                        }
+                    }
+
+                    json_data["$"]["template"] = template_data;
+                    json_data["$"]["output"] = output_data;
+
+                    SPDLOG_DEBUG("rendering output, file={}", output_data.path);
+
+                    if (!get_renderer().render_file(template_data.path, json_data, result))
+                    {
+                        throw codegen_error(codegen_error_code::rendering, "failed to render input, file={} template={}", file_data.path, template_data.path);
+                    }
+
+                    if (options.reformat)
+                    {
+                        SPDLOG_DEBUG("reformatting output, file={}", output_data.path);
+
+                        if (!get_formatter().format_file(output_data.path, result))
+                        {
+                            SPDLOG_DEBUG("failed to reformat output, file={}", output_data.path);
+                        }
+                    }
+
+                    if (artifact_cache.enabled())
+                    {
+                        std::ignore = artifact_cache.write(artifact_key, result);
+                    }
+
+                    SPDLOG_DEBUG("writing output, file={}", output_data.path);
+                    std::string output_hash = hashes::hash(cache.algorithm, result);
+                    write_group.write(output_data.path, std::move(result));
+                    written_outputs.add(output_data.path, std::move(output_key), std::move(output_hash));
+                }
+            }
+        }
+
+        // Outputs are checked like inputs, their content is only hashed when their metadata changed. The result is not
+        // recorded, so that an output that is also the input of another stage is still found changed by that stage.
+        bool is_output_up_to_date(const std::string& path, const std::string& key)
+        {
+            std::optional<codegen_cache_entry> entry;
+
+            {
+                std::scoped_lock lock {cache_mutex};
+                entry = cache.find(path);
+
+                if (!entry.has_value() || entry->key != key)
+                {
+                    return false;
+                }
+            }
+
+            const codegen_cache_check check = codegen_cache::check(path, &entry.value(), cache.algorithm);
+
+            if (!check.entry.has_value() || check.entry->hash != entry->output_hash)
+            {
+                SPDLOG_INFO("output missing or modified, file={}", path);
+                return false;
+            }
+
+            return true;
+        }
+
+        std::unordered_set<std::string> find_modified_outputs(const codegen_stage_data& stage_data)
+        {
+            std::vector<std::string> outputs;
+
+            {
+                std::scoped_lock lock {cache_mutex};
+
+                for (const codegen_file_data& file_data : stage_data.files)
+                {
+                    if (std::optional<codegen_cache_entry> entry = cache.find(current_path_scope::absolute(file_data.path).string()))
+                    {
+                        outputs.insert(outputs.end(), std::make_move_iterator(entry->outputs.begin()), std::make_move_iterator(entry->outputs.end()));
+                    }
+                }
+            }
+
+            std::vector<std::optional<codegen_cache_entry>> entries;
+            std::ignore = check_and_update_cache(outputs, &entries);
+
+            std::unordered_set<std::string> modified_outputs;
+
+            std::scoped_lock lock {cache_mutex};
+
+            for (std::size_t index = 0; index < outputs.size(); ++index)
+            {
+                const std::optional<codegen_cache_entry>& entry = entries.at(index);
+
+                if (!entry.has_value() || entry->hash != entry->output_hash)
+                {
+                    SPDLOG_INFO("output missing or modified, file={}", outputs.at(index));
+
+                    // The key is forgotten, so that the output is not skipped when its input is rendered again.
+                    cache.update_output(outputs.at(index), {}, {});
+                    modified_outputs.emplace(std::move(outputs.at(index)));
+                }
+            }
+
+            return modified_outputs;
+        }
+
+        // Outputs are recorded on their input once rendered, so that the next run can find those that went missing.
+        void update_cache_written_outputs(detail::written_outputs& written_outputs)
+        {
+            std::scoped_lock lock {cache_mutex};
+
+            for (detail::written_output& written_output : written_outputs.outputs)
+            {
+                cache.update_output(written_output.path, std::move(written_output.key), std::move(written_output.hash));
+            }
+        }
+
+        void update_cache_outputs(const codegen_stage_data& stage_data, const std::vector<std::size_t>& file_indices)
+        {
+            std::scoped_lock lock {cache_mutex};
+
+            for (const std::size_t file_index : file_indices)
+            {
+                const codegen_file_data& file_data = stage_data.files.at(file_index);
+
+                std::vector<std::string> outputs;
+                outputs.reserve(file_data.outputs.size());
+
+                for (const codegen_output_data& output_data : file_data.outputs)
+                {
+                    outputs.emplace_back(output_data.path);
+                }
+
+                std::ignore = cache.update_outputs(current_path_scope::absolute(file_data.path).string(), std::move(outputs));
+            }
+        }
+
+        codegen_renderer& get_renderer()
+        {
+            const std::size_t slot = thread_pool::current_slot();
+            return slot == 0 ? renderer : *worker_renderers.at(slot - 1);
+        }
+
+        codegen_formatter& get_formatter()
+        {
+            const std::size_t slot = thread_pool::current_slot();
+            return slot == 0 ? formatter : *worker_formatters.at(slot - 1);
+        }
+
+        template <typename ast_t>
+        static std::vector<std::shared_ptr<codegen_condition<ast_t>>> make_step_conditions(const codegen_impl<ast_t>& impl, const codegen_stage_data& stage_data)
+        {
+            std::vector<std::shared_ptr<codegen_condition<ast_t>>> step_conditions;
+            step_conditions.reserve(stage_data.steps.size());
+
+            for (const codegen_step_data& step_data : stage_data.steps)
+            {
+                step_conditions.emplace_back(step_data.condition.has_value() ? impl.condition(step_data.condition.value()) : nullptr);
+            }
+
+            return step_conditions;
+        }
+
+        template <typename ast_t>
+        static void erase_unmatched_outputs(const std::vector<std::shared_ptr<codegen_condition<ast_t>>>& step_conditions, const ast_t& ast, codegen_file_data& file_data)
+        {
+            for (std::size_t step_index = 0; step_index < step_conditions.size(); ++step_index)
+            {
+                const std::shared_ptr<codegen_condition<ast_t>>& step_condition = step_conditions.at(step_index);
+                const bool ast_matches = step_condition == nullptr || step_condition->match_ast(ast);
+
+                if (!ast_matches)
+                {
+                    const auto output_predicate = [&](const codegen_output_data& output_data) {
+                        return output_data.step_index == step_index;
+                    };
+
+                    std::erase_if(file_data.outputs, output_predicate);
+                }
+            }
+        }
+
+        codegen_data make_data()
+        {
+            codegen_data data;
+            data.stages.reserve(config.stages.size());
+
+            // Only templates named by steps are loaded, along with the templates they include, template directories
+            // are never walked.
+            std::unordered_map<std::string, std::size_t> template_indices_by_path;
+            std::vector<std::size_t> unvisited_indices;
+
+            const auto add_template = [&](const std::filesystem::path& template_file) {
+                std::string template_string = template_file.string();
+                const auto it_template = template_indices_by_path.find(template_string);
+
+                if (it_template != template_indices_by_path.end())
+                {
+                    return it_template->second;
+                }
+
+                const std::size_t template_index = data.templates.size();
+
+                codegen_template_data template_data {
+                    .path = template_string,
+                };
+
+                data.templates.emplace_back(std::move(template_data));
+                template_indices_by_path.emplace(std::move(template_string), template_index);
+                unvisited_indices.emplace_back(template_index);
+
+                return template_index;
+            };
+
+            for (const codegen_config_stage& stage : config.stages)
+            {
+                for (const codegen_config_step& step : stage.steps)
+                {
+                    for (const std::string& template_ : step.templates)
+                    {
+                        if (data.template_indices.contains(template_))
+                        {
+                            continue;
+                        }
+
+                        const std::optional<std::filesystem::path> template_file = find_template_file(template_);
+
+                        if (!template_file.has_value() || !renderer.can_render_file(template_file->string()))
+                        {
+                            SPDLOG_WARN("cannot find template, stage={} step={} template={}", stage.name, step.name, template_);
+                            continue;
+                        }
+
+                        data.template_indices.emplace(template_, add_template(template_file.value()));
+                    }
+                }
+            }
+
+            while (!unvisited_indices.empty())
+            {
+                const std::size_t template_index = unvisited_indices.back();
+                const std::string template_path = data.templates.at(template_index).path;
+                unvisited_indices.pop_back();
+
+                std::vector<std::string> includes;
+
+                if (!renderer.find_includes(template_path, includes))
+                {
+                    SPDLOG_WARN("cannot find template includes, template={}", template_path);
+                    continue;
+                }
+
+                for (const std::string& include : includes)
+                {
+                    const std::size_t include_index = add_template(current_path_scope::absolute(include).lexically_normal().make_preferred());
+                    data.templates.at(template_index).include_indices.emplace_back(include_index);
+                }
+            }
+
+            std::vector<std::string> template_paths;
+            template_paths.reserve(data.templates.size());
+
+            for (const codegen_template_data& template_data : data.templates)
+            {
+                template_paths.emplace_back(template_data.path);
+            }
+
+            const std::vector<codegen_cache_status> template_statuses = check_and_update_cache(template_paths);
+
+            for (std::size_t template_index = 0; template_index < data.templates.size(); ++template_index)
+            {
+                data.templates.at(template_index).status = template_statuses.at(template_index);
+            }
+
+            std::vector<codegen_cache_status> closure_statuses(data.templates.size());
+
+            {
+                std::scoped_lock lock {cache_mutex};
+
+                for (std::size_t template_index = 0; template_index < data.templates.size(); ++template_index)
+                {
+                    const std::vector<std::size_t> closure_indices = get_template_closure(data, template_index);
+                    std::string closure_hashes;
+
+                    closure_statuses.at(template_index) = codegen_cache_status::up_to_date;
+
+                    for (const std::size_t closure_index : closure_indices)
+                    {
+                        const codegen_template_data& closure_data = data.templates.at(closure_index);
+
+                        if (closure_data.status != codegen_cache_status::up_to_date)
+                        {
+                            closure_statuses.at(template_index) = codegen_cache_status::dirty;
+                        }
+
+                        if (const std::optional<codegen_cache_entry> entry = cache.find(closure_data.path))
+                        {
+                            closure_hashes += entry->hash;
+                        }
+                    }
+
+                    data.templates.at(template_index).hash = hashes::hash(cache.algorithm, closure_hashes);
+                }
+            }
+
+            // Templates render differently when a template they include changed, they are dirty along with them.
+            for (std::size_t template_index = 0; template_index < data.templates.size(); ++template_index)
+            {
+                codegen_template_data& template_data = data.templates.at(template_index);
+
+                if (template_data.status == codegen_cache_status::up_to_date && closure_statuses.at(template_index) != codegen_cache_status::up_to_date)
+                {
+                    SPDLOG_DEBUG("template dirty because of an include, template={}", template_data.path);
+                    template_data.status = codegen_cache_status::dirty;
+                }
+            }
+
+            for (const codegen_config_stage& stage : config.stages)
+            {
+                auto stage_func = [&] { return make_stage_data(stage, data); };
+                data.stages.emplace_back(std::move(stage_func));
+            }
+
+            return data;
+        }
+
+        // Indices of a template and of every template it includes, in the order of the templates.
+        static std::vector<std::size_t> get_template_closure(const codegen_data& data, const std::size_t template_index)
+        {
+            std::vector<bool> visited(data.templates.size());
+            std::vector<std::size_t> unvisited_indices {template_index};
+            std::vector<std::size_t> closure_indices {template_index};
+            visited.at(template_index) = true;
+
+            while (!unvisited_indices.empty())
+            {
+                const codegen_template_data& template_data = data.templates.at(unvisited_indices.back());
+                unvisited_indices.pop_back();
+
+                for (const std::size_t include_index : template_data.include_indices)
+                {
+                    if (!visited.at(include_index))
+                    {
+                        visited.at(include_index) = true;
+                        unvisited_indices.emplace_back(include_index);
+                        closure_indices.emplace_back(include_index);
+                    }
+                }
+            }
+
+            std::ranges::sort(closure_indices);
+            return closure_indices;
+        }
+
+        // Files are stat'ed and hashed on the pool, results are merged into the cache in the order of the files, so
+        // that the cache does not depend on scheduling. Entries of the files as they were just found, empty for files
+        // that could not be read, are given back on request.
+        std::vector<codegen_cache_status> check_and_update_cache(const std::vector<std::string>& files, std::vector<std::optional<codegen_cache_entry>>* checked_entries = nullptr)
+        {
+            std::vector<std::optional<codegen_cache_entry>> entries(files.size());
+
+            {
+                std::scoped_lock lock {cache_mutex};
+
+                for (std::size_t index = 0; index < files.size(); ++index)
+                {
+                    entries.at(index) = cache.find(files.at(index));
+                }
+            }
+
+            std::vector<codegen_cache_check> checks(files.size());
+
+            pool.parallel_for(files.size(), [&](const std::size_t index) {
+                const std::optional<codegen_cache_entry>& entry = entries.at(index);
+                checks.at(index) = codegen_cache::check(files.at(index), entry.has_value() ? &entry.value() : nullptr, cache.algorithm);
+            });
+
+            std::vector<codegen_cache_status> statuses;
+            statuses.reserve(files.size());
+
+            {
+                std::scoped_lock lock {cache_mutex};
+
+                for (codegen_cache_check& check : checks)
+                {
+                    if (checked_entries != nullptr)
+                    {
+                        checked_entries->emplace_back(check.entry);
+                    }
+
+                    // A file checked more than once during a run, e.g. as an input and as a dependency, keeps the
+                    // status it had when it was first found changed, since its entry is up-to-date the next time.
+                    std::string file = check.file;
+                    const codegen_cache_status status = cache.update(std::move(check));
+                    const auto [it_status, inserted] = cache_statuses.try_emplace(std::move(file), status);
+
+                    if (!inserted && it_status->second == codegen_cache_status::up_to_date)
+                    {
+                        it_status->second = status;
+                    }
+
+                    statuses.emplace_back(it_status->second);
+                }
+            }
+
+            return statuses;
+        }
+
+        // Files that did not change are still dirty when one of the files they were parsed with did, e.g. a header
+        // included by a C++ input.
+        void check_cache_dependencies(const std::vector<std::string>& files, std::vector<codegen_cache_status>& statuses)
+        {
+            std::vector<std::vector<std::string>> file_dependencies(files.size());
+
+            {
+                std::scoped_lock lock {cache_mutex};
+
+                for (std::size_t index = 0; index < files.size(); ++index)
+                {
+                    if (statuses.at(index) == codegen_cache_status::up_to_date)
+                    {
+                        if (std::optional<codegen_cache_entry> entry = cache.find(files.at(index)))
+                        {
+                            file_dependencies.at(index) = std::move(entry->dependencies);
+                        }
+                    }
+                }
+            }
+
+            const std::vector<std::string> dependencies = get_unique_dependencies(file_dependencies);
+            const std::vector<codegen_cache_status> dependency_statuses = check_and_update_cache(dependencies);
+
+            std::unordered_map<std::string_view, codegen_cache_status> dependency_status_map;
+            dependency_status_map.reserve(dependencies.size());
+
+            for (std::size_t index = 0; index < dependencies.size(); ++index)
+            {
+                dependency_status_map.emplace(dependencies.at(index), dependency_statuses.at(index));
+            }
+
+            for (std::size_t index = 0; index < files.size(); ++index)
+            {
+                const auto dependency_predicate = [&](const std::string& dependency) {
+                    return dependency_status_map.at(dependency) != codegen_cache_status::up_to_date;
+                };
+
+                if (std::ranges::any_of(file_dependencies.at(index), dependency_predicate))
+                {
+                    SPDLOG_DEBUG("file dirty because of a dependency, file={}", files.at(index));
+                    statuses.at(index) = codegen_cache_status::dirty;
+                }
+            }
+        }
+
+        // Dependencies are checked when they are recorded, so that the cache has an entry to compare them with on the
+        // next run.
+        void update_cache_dependencies(const std::vector<std::string>& files, std::vector<std::vector<std::string>>& file_dependencies)
+        {
+            std::ignore = check_and_update_cache(get_unique_dependencies(file_dependencies));
+
+            std::scoped_lock lock {cache_mutex};
+
+            for (std::size_t index = 0; index < files.size(); ++index)
+            {
+                std::ignore = cache.update_dependencies(current_path_scope::absolute(files.at(index)).string(), std::move(file_dependencies.at(index)));
+            }
+        }
+
+        static std::vector<std::string> get_unique_dependencies(const std::vector<std::vector<std::string>>& file_dependencies)
+        {
+            std::vector<std::string> dependencies;
+
+            for (const std::vector<std::string>& file_dependency : file_dependencies)
+            {
+                dependencies.insert(dependencies.end(), file_dependency.begin(), file_dependency.end());
+            }
+
+            std::ranges::sort(dependencies);
+            dependencies.erase(std::ranges::unique(dependencies).begin(), dependencies.end());
+            return dependencies;
+        }
+
+        std::optional<std::filesystem::path> find_template_file(const std::string& template_) const
+        {
+            const std::filesystem::path template_path = std::filesystem::path(template_).make_preferred();
+
+            if (template_path.is_absolute())
+            {
+                return std::filesystem::exists(template_path) ? std::optional {template_path.lexically_normal()} : std::nullopt;
+            }
+
+            for (const std::string& template_directory : options.templates)
+            {
+                std::filesystem::path template_file = std::filesystem::path(template_directory) / template_path;
+
+                if (std::filesystem::exists(template_file))
+                {
+                    return template_file.lexically_normal();
+                }
+            }
+
+            return std::nullopt;
+        }
+
+        // Files matching the patterns of a stage, searched from the current directory, which is the one of the stage.
+        std::vector<std::filesystem::path> find_stage_files(const codegen_config_stage& stage)
+        {
+            const std::filesystem::path stage_directory = current_path_scope::current_path();
+            std::vector<std::filesystem::path> stage_files;
+
+            for (const std::string& pattern : stage.files)
+            {
+                const bool is_pattern_absolute = std::filesystem::path(pattern).is_absolute();
+                std::vector<std::filesystem::path> pattern_files;
+
+                {
+                    // Glob lazily initializes shared static state, stages must not glob concurrently.
+                    std::scoped_lock lock {glob_mutex};
+                    pattern_files = glob::rglob((stage_directory / pattern).string());
+                }
+
+                for (std::filesystem::path& stage_file : pattern_files)
+                {
+                    // Keep paths relative to the stage directory, they are used as is in templates and outputs.
+                    stage_files.emplace_back(is_pattern_absolute ? std::move(stage_file) : stage_file.lexically_relative(stage_directory));
+                }
+            }
+
+            return stage_files;
+        }
+
+        codegen_stage_data make_stage_data(const codegen_config_stage& stage, const codegen_data& data)
+        {
+            codegen_stage_data stage_data;
+
+            {
+                current_path_scope directory_scope {stage.directory};
+                const std::vector<std::filesystem::path> stage_files = find_stage_files(stage);
+
+                std::vector<std::string> stage_files_abs;
+                stage_files_abs.reserve(stage_files.size());
+
+                for (const std::filesystem::path& stage_file : stage_files)
+                {
+                    stage_files_abs.emplace_back(current_path_scope::absolute(stage_file).string());
+                }
+
+                std::vector<codegen_cache_status> statuses = check_and_update_cache(stage_files_abs);
+                check_cache_dependencies(stage_files_abs, statuses);
+                stage_data.files.reserve(stage_files.size());
+
+                for (std::size_t file_index = 0; file_index < stage_files.size(); ++file_index)
+                {
+                    codegen_file_data file_data {
+                        .path = stage_files.at(file_index).string(),
+                        .status = statuses.at(file_index),
+                    };
+
+                    stage_data.files.emplace_back(std::move(file_data));
+                }
+            }
+
+            for (std::size_t step_index = 0; step_index < stage.steps.size(); ++step_index)
+            {
+                const codegen_config_step& step = stage.steps.at(step_index);
+
+                const nlohmann::json step_json {
+                    {"name", step.name},
+                    {"directory", step.directory},
+                    {"templates", step.templates},
+                    {"data", step.data},
+                    {"condition", step.condition.value_or(nullptr)},
+                    {"reformat", static_cast<bool>(options.reformat)},
+                };
+
+                codegen_step_data step_data {
+                    .condition = step.condition,
+                    .hash = hashes::hash(cache.algorithm, step_json.dump() + user_data_hash),
+                };
+
+                {
+                    std::scoped_lock lock {cache_mutex};
+                    const std::optional<std::string> step_hash = cache.find_fingerprint(get_step_fingerprint_name(stage, step_index));
+
+                    if (!step_hash.has_value())
+                    {
+                        step_data.status = codegen_cache_status::new_;
+                    }
+                    else
+                    {
+                        step_data.status = step_hash == step_data.hash ? codegen_cache_status::up_to_date : codegen_cache_status::dirty;
+                    }
+                }
+
+                for (const std::string& template_ : step.templates)
+                {
+                    const auto it_template_index = data.template_indices.find(template_);
+                    if (it_template_index != data.template_indices.end())
                     {
-                        std::size_t template_index = static_cast<std::size_t>(it_template - data.templates.begin());
+                        const std::size_t template_index = it_template_index->second;
+                        const codegen_template_data& template_data = data.templates.at(template_index);
                         step_data.template_indices.emplace_back(template_index);
 
                         for (codegen_file_data& file_data : stage_data.files)
                         {
                             const auto output_stem = std::filesystem::path(file_data.path).stem();
                             const auto output_directory = std::filesystem::path(step.directory) / std::filesystem::path(file_data.path).parent_path();
-                            const auto output_prefix = std::filesystem::absolute(output_directory / output_stem);
-                            const auto output_suffix = std::filesystem::path(it_template->path).stem();
+                            const auto output_prefix = current_path_scope::absolute(output_directory / output_stem);
+                            const auto output_suffix = std::filesystem::path(template_data.path).stem();
 
                             codegen_output_data output_data {
                                 .step_index = step_index,
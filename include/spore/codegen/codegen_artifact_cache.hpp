@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+
+#include "spore/codegen/codegen_error.hpp"
+#include "spore/codegen/misc/mapped_file.hpp"
+#include "spore/codegen/utils/files.hpp"
+#include "spore/codegen/utils/hashes.hpp"
+#include "spore/codegen/utils/json.hpp"
+
+namespace spore::codegen
+{
+    struct codegen_artifact_dependency
+    {
+        std::string path;
+        std::string hash;
+    };
+
+    // Converted data of an input, along with what it was parsed with. Dependencies are relative to the directory of
+    // the stage, so that artifacts can be shared between working copies in different directories.
+    struct codegen_input_artifact
+    {
+        std::string key;
+        std::vector<codegen_artifact_dependency> dependencies;
+        std::vector<std::size_t> step_indices;
+        nlohmann::json data;
+    };
+
+    namespace detail
+    {
+        constexpr std::string_view artifact_context = "artifact";
+    }
+
+    inline void to_json(nlohmann::json& json, const codegen_artifact_dependency& value)
+    {
+        json["path"] = value.path;
+        json["hash"] = hashes::to_hex(value.hash);
+    }
+
+    inline void from_json(const nlohmann::json& json, codegen_artifact_dependency& value)
+    {
+        std::string hash;
+        json::get_checked(json, "path", value.path, detail::artifact_context);
+        json::get_checked(json, "hash", hash, detail::artifact_context);
+
+        if (!hashes::from_hex(hash, value.hash))
+        {
+            throw codegen_error(codegen_error_code::invalid, "invalid artifact hash, file={} hash={}", value.path, hash);
+        }
+    }
+
+    inline void to_json(nlohmann::json& json, const codegen_input_artifact& value)
+    {
+        json["key"] = hashes::to_hex(value.key);
+        json["dependencies"] = value.dependencies;
+        json["steps"] = value.step_indices;
+        json["data"] = value.data;
+    }
+
+    inline void from_json(const nlohmann::json& json, codegen_input_artifact& value)
+    {
+        std::string key;
+        json::get_checked(json, "key", key, detail::artifact_context);
+
+        if (!hashes::from_hex(key, value.key))
+        {
+            throw codegen_error(codegen_error_code::invalid, "invalid artifact key, key={}", key);
+        }
+
+        json::get_checked(json, "dependencies", value.dependencies, detail::artifact_context);
+        json::get_checked(json, "steps", value.step_indices, detail::artifact_context);
+        json::get_checked(json, "data", value.data, detail::artifact_context);
+    }
+
+    // Content addressed store of parser results and rendered outputs, shared by every run that points to the same
+    // directory, e.g. on a network drive for CI agents and developers. Artifacts are named after the digest of their
+    // key and written atomically, so that concurrent runs never see partial artifacts and need no locking. A missing
+    // or unreadable artifact is only a miss, the store never fails a run. Artifacts are never removed, the modification
+    // time of each artifact is refreshed when it is read, so that the store can be pruned by age from outside, e.g. by
+    // a scheduled `find <directory> -type f -mtime +30 -delete`.
+    struct codegen_artifact_cache
+    {
+        codegen_artifact_cache() = default;
+
+        codegen_artifact_cache(std::string directory, const hashes::hash_algorithm algorithm)
+            : _directory(std::move(directory)),
+              _algorithm(algorithm)
+        {
+        }
+
+        [[nodiscard]] bool enabled() const
+        {
+            return !_directory.empty();
+        }
+
+        // Parts are prefixed with their size, so that different parts never give the same key.
+        [[nodiscard]] std::string make_key(const std::initializer_list<std::string_view> parts) const
+        {
+            std::string key_data;
+
+            for (const std::string_view part : parts)
+            {
+                key_data += std::to_string(part.size());
+                key_data += ':';
+                key_data += part;
+            }
+
+            return hashes::hash(_algorithm, key_data);
+        }
+
+        [[nodiscard]] bool read(const std::string_view key, std::string& content) const
+        {
+            mapped_file file;
+
+            if (!file.open(get_path(key)))
+            {
+                return false;
+            }
+
+            content.assign(file.text());
+            touch(get_path(key));
+            return true;
+        }
+
+        [[nodiscard]] bool read(const std::string_view key, codegen_input_artifact& artifact) const
+        {
+            return read(key, key, artifact);
+        }
+
+        // Artifacts may be stored under another name than their key, e.g. one name per input so that each input only
+        // keeps its last artifact, they are then only read back while their key is the same.
+        [[nodiscard]] bool read(const std::string_view name, const std::string_view key, codegen_input_artifact& artifact) const
+        {
+            mapped_file file;
+
+            if (!file.open(get_path(name)))
+            {
+                return false;
+            }
+
+            try
+            {
+                artifact = nlohmann::json::from_cbor(file.bytes().begin(), file.bytes().end());
+            }
+            catch (const std::exception& e)
+            {
+                SPDLOG_DEBUG("ignoring invalid artifact, file={} error={}", get_path(name).string(), e.what());
+                return false;
+            }
+
+            if (artifact.key != key)
+            {
+                return false;
+            }
+
+            touch(get_path(name));
+            return true;
+        }
+
+        bool write(const std::string_view key, const std::string& content) const
+        {
+            const std::string path = get_path(key).string();
+
+            // Outputs are stored as is, without newline conversions, since they are read back as bytes.
+            if (!files::write_file(path, std::vector<std::uint8_t>(content.begin(), content.end())))
+            {
+                SPDLOG_DEBUG("failed to write artifact, file={}", path);
+                return false;
+            }
+
+            return true;
+        }
+
+        bool write(const std::string_view name, const codegen_input_artifact& artifact) const
+        {
+            const std::string path = get_path(name).string();
+
+            if (!files::write_file(path, nlohmann::json::to_cbor(nlohmann::json(artifact))))
+            {
+                SPDLOG_DEBUG("failed to write artifact, file={}", path);
+                return false;
+            }
+
+            return true;
+        }
+
+      private:
+        std::string _directory;
+        hashes::hash_algorithm _algorithm = hashes::hash_algorithm::xxh3;
+
+        // Artifacts are spread over subdirectories named after the first byte of their name, like git objects.
+        [[nodiscard]] std::filesystem::path get_path(const std::string_view name) const
+        {
+            const std::string hex = hashes::to_hex(name);
+            return std::filesystem::path(_directory) / hex.substr(0, 2) / hex.substr(2);
+        }
+
+        static void touch(const std::filesystem::path& path)
+        {
+            std::error_code error;
+            std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        }
+    };
+}
\ No newline at end of file
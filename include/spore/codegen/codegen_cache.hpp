@@ -1,17 +1,57 @@
 #pragma once
 
-#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <functional>
 #include <map>
-#include <set>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 
+#include "spore/codegen/codegen_error.hpp"
 #include "spore/codegen/codegen_version.hpp"
+#include "spore/codegen/misc/current_path_scope.hpp"
+#include "spore/codegen/misc/file_lock.hpp"
+#include "spore/codegen/misc/mapped_file.hpp"
 #include "spore/codegen/utils/files.hpp"
+#include "spore/codegen/utils/hashes.hpp"
 #include "spore/codegen/utils/json.hpp"
 
+namespace spore::codegen::hashes
+{
+    inline void to_json(nlohmann::json& json, const hash_algorithm& value)
+    {
+        json = to_string(value);
+    }
+
+    inline void from_json(const nlohmann::json& json, hash_algorithm& value)
+    {
+        const std::optional<hash_algorithm> algorithm = from_string(json.get<std::string>());
+
+        if (!algorithm.has_value())
+        {
+            throw codegen_error(codegen_error_code::invalid, "invalid hash algorithm, algorithm={}", json.dump());
+        }
+
+        value = algorithm.value();
+    }
+}
+
 namespace spore::codegen
 {
     enum class codegen_cache_status
@@ -26,111 +66,1245 @@ namespace spore::codegen
         std::string file;
         std::string hash;
         std::size_t size = 0;
+        std::int64_t mtime = 0;
+        std::int64_t ctime = 0;
+        std::uint64_t inode = 0;
+
+        // Absolute paths of the files read along with this one when it was parsed, e.g. included headers.
+        std::vector<std::string> dependencies;
+
+        // Absolute paths of the outputs rendered from this file.
+        std::vector<std::string> outputs;
+
+        // Digest of everything an output was rendered from, empty for files that are not outputs.
+        std::string key;
+
+        // Digest of the content an output was written with, the file was modified since if its hash differs.
+        std::string output_hash;
+
+        bool operator==(const codegen_cache_entry&) const = default;
     };
 
-    struct codegen_cache
+    struct codegen_cache_check
+    {
+        std::string file;
+        codegen_cache_status status = codegen_cache_status::dirty;
+        std::optional<codegen_cache_entry> entry;
+    };
+
+    namespace detail
+    {
+        constexpr std::string_view cache_context = "cache";
+    }
+
+    inline void to_json(nlohmann::json& json, const codegen_cache_entry& value)
+    {
+        json["file"] = value.file;
+        json["hash"] = hashes::to_hex(value.hash);
+        json["size"] = value.size;
+        json["mtime"] = value.mtime;
+        json["ctime"] = value.ctime;
+        json["inode"] = value.inode;
+
+        if (!value.dependencies.empty())
+        {
+            json["dependencies"] = value.dependencies;
+        }
+
+        if (!value.outputs.empty())
+        {
+            json["outputs"] = value.outputs;
+        }
+
+        if (!value.key.empty())
+        {
+            json["key"] = hashes::to_hex(value.key);
+        }
+
+        if (!value.output_hash.empty())
+        {
+            json["output_hash"] = hashes::to_hex(value.output_hash);
+        }
+    }
+
+    inline void from_json(const nlohmann::json& json, codegen_cache_entry& value)
+    {
+        json::get_checked(json, "file", value.file, detail::cache_context);
+        std::string hash;
+        json::get_checked(json, "hash", hash, detail::cache_context);
+        json::get_checked(json, "size", value.size, detail::cache_context);
+        json::get_opt(json, "mtime", value.mtime);
+        json::get_opt(json, "ctime", value.ctime);
+        json::get_opt(json, "inode", value.inode);
+        json::get_opt(json, "dependencies", value.dependencies);
+        json::get_opt(json, "outputs", value.outputs);
+        std::string key;
+        json::get_opt(json, "key", key);
+        std::string output_hash;
+        json::get_opt(json, "output_hash", output_hash);
+
+        // Digests are kept in binary and stored as hexadecimal in text formats.
+        if (!hashes::from_hex(hash, value.hash))
+        {
+            throw codegen_error(codegen_error_code::invalid, "invalid cache hash, file={} hash={}", value.file, hash);
+        }
+
+        if (!hashes::from_hex(key, value.key))
+        {
+            throw codegen_error(codegen_error_code::invalid, "invalid cache key, file={} key={}", value.file, key);
+        }
+
+        if (!hashes::from_hex(output_hash, value.output_hash))
+        {
+            throw codegen_error(codegen_error_code::invalid, "invalid cache output hash, file={} hash={}", value.file, output_hash);
+        }
+    }
+
+    namespace detail
     {
-        struct entry_comparator
+        struct cache_string_hash
         {
             using is_transparent = void;
 
-            bool operator()(const codegen_cache_entry& entry, const codegen_cache_entry& other_entry) const
+            std::size_t operator()(const std::string_view value) const
+            {
+                return std::hash<std::string_view> {}(value);
+            }
+        };
+
+        // Binary cache layout, in native byte order:
+        //   header | version | entries | buckets | dependencies | fingerprints | strings
+        // Sections are aligned on 8 bytes. Buckets are an open addressing hash table of entry indices, keyed by the
+        // XXH3 hash of the file path, so that entries can be looked up in the mapped file without being loaded.
+        // Dependencies and outputs of an entry are ranges of string references, each distinct path is stored once.
+        // Fingerprints are pairs of string references, a name and a digest.
+        constexpr std::array<char, 8> binary_cache_magic {'S', 'P', 'C', 'A', 'C', 'H', 'E', '\0'};
+        constexpr std::uint32_t binary_cache_format = 5;
+        constexpr std::uint32_t binary_cache_empty_bucket = UINT32_MAX;
+
+        struct binary_cache_header
+        {
+            std::array<char, 8> magic = binary_cache_magic;
+            std::uint32_t format = binary_cache_format;
+            std::uint32_t byte_order = 0x01020304;
+            std::uint32_t algorithm = 0;
+            std::uint32_t version_size = 0;
+            std::uint32_t entry_count = 0;
+            std::uint32_t bucket_count = 0;
+            std::uint32_t dependency_count = 0;
+            std::uint32_t fingerprint_count = 0;
+            std::uint64_t strings_size = 0;
+        };
+
+        struct binary_cache_string
+        {
+            std::uint64_t offset = 0;
+            std::uint64_t size = 0;
+        };
+
+        struct binary_cache_fingerprint
+        {
+            binary_cache_string name;
+            binary_cache_string hash;
+        };
+
+        struct binary_cache_entry
+        {
+            std::uint64_t file_offset = 0;
+            std::uint32_t file_size = 0;
+            std::uint32_t hash_size = 0;
+            std::uint64_t size = 0;
+            std::int64_t mtime = 0;
+            std::int64_t ctime = 0;
+            std::uint64_t inode = 0;
+            std::uint32_t dependency_index = 0;
+            std::uint32_t dependency_count = 0;
+            std::uint32_t output_index = 0;
+            std::uint32_t output_count = 0;
+            std::array<std::uint8_t, 32> hash {};
+            std::array<std::uint8_t, 32> key {};
+            std::array<std::uint8_t, 32> output_hash {};
+            std::uint32_t key_size = 0;
+            std::uint32_t output_hash_size = 0;
+        };
+
+        // Structures are written as is, they must not have padding, which would be written uninitialized.
+        static_assert(std::has_unique_object_representations_v<binary_cache_header>);
+        static_assert(std::has_unique_object_representations_v<binary_cache_string>);
+        static_assert(std::has_unique_object_representations_v<binary_cache_fingerprint>);
+        static_assert(std::has_unique_object_representations_v<binary_cache_entry>);
+
+        constexpr std::size_t align_binary_cache(const std::size_t offset)
+        {
+            return (offset + 7) & ~std::size_t {7};
+        }
+
+        inline std::uint64_t hash_binary_cache_file(const std::string_view file)
+        {
+            return XXH3_64bits(file.data(), file.size());
+        }
+
+        // Entries of a binary cache file, read in place from the mapped file.
+        struct binary_cache_view
+        {
+            bool open(mapped_file in_file)
+            {
+                _file = std::move(in_file);
+
+                const std::span<const std::uint8_t> bytes = _file.bytes();
+                if (bytes.size() < sizeof(binary_cache_header))
+                {
+                    return false;
+                }
+
+                std::memcpy(&_header, bytes.data(), sizeof(binary_cache_header));
+
+                if (_header.magic != binary_cache_magic || _header.format != binary_cache_format || _header.byte_order != 0x01020304)
+                {
+                    return false;
+                }
+
+                if (_header.bucket_count != 0 && !std::has_single_bit(_header.bucket_count))
+                {
+                    return false;
+                }
+
+                _version_offset = sizeof(binary_cache_header);
+                _entries_offset = align_binary_cache(_version_offset + _header.version_size);
+                _buckets_offset = align_binary_cache(_entries_offset + std::size_t {_header.entry_count} * sizeof(binary_cache_entry));
+                _dependencies_offset = align_binary_cache(_buckets_offset + std::size_t {_header.bucket_count} * sizeof(std::uint32_t));
+                _fingerprints_offset = align_binary_cache(_dependencies_offset + std::size_t {_header.dependency_count} * sizeof(binary_cache_string));
+                _strings_offset = align_binary_cache(_fingerprints_offset + std::size_t {_header.fingerprint_count} * sizeof(binary_cache_fingerprint));
+
+                return _strings_offset + _header.strings_size <= bytes.size();
+            }
+
+            [[nodiscard]] std::string_view version() const
+            {
+                return _file.text().substr(_version_offset, _header.version_size);
+            }
+
+            [[nodiscard]] std::uint32_t algorithm() const
             {
-                return entry.file < other_entry.file;
+                return _header.algorithm;
             }
 
-            bool operator()(const codegen_cache_entry& entry, const std::string_view& other_file) const
+            [[nodiscard]] std::size_t size() const
             {
-                return entry.file < other_file;
+                return _header.entry_count;
             }
 
-            bool operator()(const std::string_view& file, const codegen_cache_entry& other_entry) const
+            [[nodiscard]] std::optional<codegen_cache_entry> find(const std::string_view file_path) const
+            {
+                if (_header.bucket_count == 0)
+                {
+                    return std::nullopt;
+                }
+
+                const std::size_t mask = _header.bucket_count - 1;
+                std::size_t bucket = static_cast<std::size_t>(hash_binary_cache_file(file_path)) & mask;
+
+                for (std::size_t probe = 0; probe < _header.bucket_count; ++probe)
+                {
+                    std::uint32_t entry_index;
+                    std::memcpy(&entry_index, _file.bytes().data() + _buckets_offset + bucket * sizeof(std::uint32_t), sizeof(std::uint32_t));
+
+                    if (entry_index == binary_cache_empty_bucket || entry_index >= _header.entry_count)
+                    {
+                        return std::nullopt;
+                    }
+
+                    const binary_cache_entry entry = entry_at(entry_index);
+
+                    if (entry_file(entry) == file_path)
+                    {
+                        return to_entry(entry);
+                    }
+
+                    bucket = (bucket + 1) & mask;
+                }
+
+                return std::nullopt;
+            }
+
+            template <typename func_t>
+            void for_each(func_t&& func) const
+            {
+                for (std::size_t entry_index = 0; entry_index < _header.entry_count; ++entry_index)
+                {
+                    func(to_entry(entry_at(entry_index)));
+                }
+            }
+
+            template <typename func_t>
+            void for_each_fingerprint(func_t&& func) const
+            {
+                for (std::size_t fingerprint_index = 0; fingerprint_index < _header.fingerprint_count; ++fingerprint_index)
+                {
+                    binary_cache_fingerprint fingerprint;
+                    std::memcpy(&fingerprint, _file.bytes().data() + _fingerprints_offset + fingerprint_index * sizeof(binary_cache_fingerprint), sizeof(binary_cache_fingerprint));
+                    func(string_at(fingerprint.name.offset, fingerprint.name.size), string_at(fingerprint.hash.offset, fingerprint.hash.size));
+                }
+            }
+
+          private:
+            mapped_file _file;
+            binary_cache_header _header;
+            std::size_t _version_offset = 0;
+            std::size_t _entries_offset = 0;
+            std::size_t _buckets_offset = 0;
+            std::size_t _dependencies_offset = 0;
+            std::size_t _fingerprints_offset = 0;
+            std::size_t _strings_offset = 0;
+
+            [[nodiscard]] binary_cache_entry entry_at(const std::size_t entry_index) const
             {
-                return file < other_entry.file;
+                binary_cache_entry entry;
+                std::memcpy(&entry, _file.bytes().data() + _entries_offset + entry_index * sizeof(binary_cache_entry), sizeof(binary_cache_entry));
+                return entry;
+            }
+
+            [[nodiscard]] std::string_view entry_file(const binary_cache_entry& entry) const
+            {
+                return string_at(entry.file_offset, entry.file_size);
+            }
+
+            [[nodiscard]] std::vector<std::string> entry_paths(const std::uint32_t path_index, const std::uint32_t path_count) const
+            {
+                std::vector<std::string> paths;
+
+                if (std::size_t {path_index} + path_count > _header.dependency_count)
+                {
+                    return paths;
+                }
+
+                paths.reserve(path_count);
+
+                for (std::size_t index = path_index; index < std::size_t {path_index} + path_count; ++index)
+                {
+                    binary_cache_string path;
+                    std::memcpy(&path, _file.bytes().data() + _dependencies_offset + index * sizeof(binary_cache_string), sizeof(binary_cache_string));
+                    paths.emplace_back(string_at(path.offset, path.size));
+                }
+
+                return paths;
+            }
+
+            [[nodiscard]] std::string_view string_at(const std::uint64_t offset, const std::uint64_t size) const
+            {
+                if (offset > _header.strings_size || size > _header.strings_size - offset)
+                {
+                    return {};
+                }
+
+                return _file.text().substr(_strings_offset + offset, size);
+            }
+
+            [[nodiscard]] codegen_cache_entry to_entry(const binary_cache_entry& entry) const
+            {
+                const std::size_t hash_size = std::min<std::size_t>(entry.hash_size, entry.hash.size());
+                const std::size_t key_size = std::min<std::size_t>(entry.key_size, entry.key.size());
+                const std::size_t output_hash_size = std::min<std::size_t>(entry.output_hash_size, entry.output_hash.size());
+
+                return codegen_cache_entry {
+                    .file = std::string(entry_file(entry)),
+                    .hash = std::string(reinterpret_cast<const char*>(entry.hash.data()), hash_size),
+                    .size = static_cast<std::size_t>(entry.size),
+                    .mtime = entry.mtime,
+                    .ctime = entry.ctime,
+                    .inode = entry.inode,
+                    .dependencies = entry_paths(entry.dependency_index, entry.dependency_count),
+                    .outputs = entry_paths(entry.output_index, entry.output_count),
+                    .key = std::string(reinterpret_cast<const char*>(entry.key.data()), key_size),
+                    .output_hash = std::string(reinterpret_cast<const char*>(entry.output_hash.data()), output_hash_size),
+                };
             }
         };
 
-        std::string version;
-        std::set<codegen_cache_entry, entry_comparator> entries;
+        inline void append_binary_cache(std::vector<std::uint8_t>& bytes, const void* data, const std::size_t size)
+        {
+            const auto* begin = static_cast<const std::uint8_t*>(data);
+            bytes.insert(bytes.end(), begin, begin + size);
+        }
+
+        using cache_fingerprints_t = std::map<std::string, std::string, std::less<>>;
+
+        inline std::vector<std::uint8_t> make_binary_cache(const std::string_view version, const hashes::hash_algorithm algorithm, const std::vector<codegen_cache_entry>& entries, const cache_fingerprints_t& fingerprints)
+        {
+            // Buckets are kept at most half full, so that probe sequences stay short.
+            const std::uint32_t bucket_count = entries.empty() ? 0 : std::bit_ceil(static_cast<std::uint32_t>(entries.size() * 2));
+
+            std::vector<std::uint32_t> buckets(bucket_count, binary_cache_empty_bucket);
+            std::vector<binary_cache_entry> binary_entries;
+            std::vector<binary_cache_string> dependencies;
+            std::unordered_map<std::string_view, binary_cache_string> string_map;
+            std::string strings;
+
+            binary_entries.reserve(entries.size());
+
+            // Paths are stored once, however many entries depend on them.
+            const auto add_string = [&](const std::string_view value) {
+                const auto [it_string, inserted] = string_map.try_emplace(value);
+
+                if (inserted)
+                {
+                    it_string->second = {
+                        .offset = strings.size(),
+                        .size = value.size(),
+                    };
+
+                    strings += value;
+                }
+
+                return it_string->second;
+            };
+
+            for (const codegen_cache_entry& entry : entries)
+            {
+                const binary_cache_string file = add_string(entry.file);
+
+                binary_cache_entry& binary_entry = binary_entries.emplace_back();
+                binary_entry.file_offset = file.offset;
+                binary_entry.file_size = static_cast<std::uint32_t>(file.size);
+                binary_entry.hash_size = static_cast<std::uint32_t>(std::min(entry.hash.size(), binary_entry.hash.size()));
+                binary_entry.size = entry.size;
+                binary_entry.mtime = entry.mtime;
+                binary_entry.ctime = entry.ctime;
+                binary_entry.inode = entry.inode;
+                binary_entry.dependency_index = static_cast<std::uint32_t>(dependencies.size());
+                binary_entry.dependency_count = static_cast<std::uint32_t>(entry.dependencies.size());
+                binary_entry.output_index = static_cast<std::uint32_t>(dependencies.size() + entry.dependencies.size());
+                binary_entry.output_count = static_cast<std::uint32_t>(entry.outputs.size());
+                binary_entry.key_size = static_cast<std::uint32_t>(std::min(entry.key.size(), binary_entry.key.size()));
+                binary_entry.output_hash_size = static_cast<std::uint32_t>(std::min(entry.output_hash.size(), binary_entry.output_hash.size()));
+                std::memcpy(binary_entry.hash.data(), entry.hash.data(), binary_entry.hash_size);
+                std::memcpy(binary_entry.key.data(), entry.key.data(), binary_entry.key_size);
+                std::memcpy(binary_entry.output_hash.data(), entry.output_hash.data(), binary_entry.output_hash_size);
+
+                for (const std::string& dependency : entry.dependencies)
+                {
+                    dependencies.emplace_back(add_string(dependency));
+                }
+
+                for (const std::string& output : entry.outputs)
+                {
+                    dependencies.emplace_back(add_string(output));
+                }
+
+                std::size_t bucket = static_cast<std::size_t>(hash_binary_cache_file(entry.file)) & (bucket_count - 1);
+
+                while (buckets.at(bucket) != binary_cache_empty_bucket)
+                {
+                    bucket = (bucket + 1) & (bucket_count - 1);
+                }
+
+                buckets.at(bucket) = static_cast<std::uint32_t>(binary_entries.size() - 1);
+            }
+
+            std::vector<binary_cache_fingerprint> binary_fingerprints;
+            binary_fingerprints.reserve(fingerprints.size());
+
+            for (const auto& [name, hash] : fingerprints)
+            {
+                const binary_cache_fingerprint binary_fingerprint {
+                    .name = add_string(name),
+                    .hash = add_string(hash),
+                };
+
+                binary_fingerprints.emplace_back(binary_fingerprint);
+            }
+
+            const binary_cache_header header {
+                .algorithm = static_cast<std::uint32_t>(algorithm),
+                .version_size = static_cast<std::uint32_t>(version.size()),
+                .entry_count = static_cast<std::uint32_t>(binary_entries.size()),
+                .bucket_count = bucket_count,
+                .dependency_count = static_cast<std::uint32_t>(dependencies.size()),
+                .fingerprint_count = static_cast<std::uint32_t>(binary_fingerprints.size()),
+                .strings_size = strings.size(),
+            };
+
+            std::vector<std::uint8_t> bytes;
+            const auto pad = [&] { bytes.resize(align_binary_cache(bytes.size())); };
+
+            append_binary_cache(bytes, &header, sizeof(header));
+            append_binary_cache(bytes, version.data(), version.size());
+            pad();
+            append_binary_cache(bytes, binary_entries.data(), binary_entries.size() * sizeof(binary_cache_entry));
+            pad();
+            append_binary_cache(bytes, buckets.data(), buckets.size() * sizeof(std::uint32_t));
+            pad();
+            append_binary_cache(bytes, dependencies.data(), dependencies.size() * sizeof(binary_cache_string));
+            pad();
+            append_binary_cache(bytes, binary_fingerprints.data(), binary_fingerprints.size() * sizeof(binary_cache_fingerprint));
+            pad();
+            append_binary_cache(bytes, strings.data(), strings.size());
+
+            return bytes;
+        }
+
+        inline std::optional<hashes::hash_algorithm> to_hash_algorithm(const std::uint32_t value)
+        {
+            for (const hashes::hash_algorithm algorithm : {hashes::hash_algorithm::xxh3, hashes::hash_algorithm::sha256})
+            {
+                if (static_cast<std::uint32_t>(algorithm) == value)
+                {
+                    return algorithm;
+                }
+            }
+
+            return std::nullopt;
+        }
+
+        // Journal layout, in native byte order:
+        //   header | version | records
+        // Each record is an entry or a fingerprint updated since the cache file was written, in CBOR, preceded by its
+        // checksum and its size. A record torn by an interrupted run is dropped along with everything after it.
+        constexpr std::array<char, 8> binary_journal_magic {'S', 'P', 'C', 'J', 'R', 'N', 'L', '\0'};
+        constexpr std::uint32_t binary_journal_format = 1;
+
+        struct binary_journal_header
+        {
+            std::array<char, 8> magic = binary_journal_magic;
+            std::uint32_t format = binary_journal_format;
+            std::uint32_t byte_order = 0x01020304;
+            std::uint32_t algorithm = 0;
+            std::uint32_t version_size = 0;
+        };
+
+        struct binary_journal_record
+        {
+            std::uint64_t checksum = 0;
+            std::uint32_t size = 0;
+            std::uint32_t reserved = 0;
+        };
+
+        static_assert(std::has_unique_object_representations_v<binary_journal_header>);
+        static_assert(std::has_unique_object_representations_v<binary_journal_record>);
+
+        inline std::string get_lock_path(const std::string_view path)
+        {
+            return std::string(path) + ".lock";
+        }
+
+        inline std::string get_journal_path(const std::string_view path)
+        {
+            return std::string(path) + ".journal";
+        }
+
+        inline void append_binary_journal_header(std::vector<std::uint8_t>& bytes, const std::string_view version, const hashes::hash_algorithm algorithm)
+        {
+            const binary_journal_header header {
+                .algorithm = static_cast<std::uint32_t>(algorithm),
+                .version_size = static_cast<std::uint32_t>(version.size()),
+            };
+
+            append_binary_cache(bytes, &header, sizeof(header));
+            append_binary_cache(bytes, version.data(), version.size());
+        }
+
+        inline void append_binary_journal_record(std::vector<std::uint8_t>& bytes, const nlohmann::json& json)
+        {
+            const std::vector<std::uint8_t> data = nlohmann::json::to_cbor(json);
+
+            const binary_journal_record record {
+                .checksum = XXH3_64bits(data.data(), data.size()),
+                .size = static_cast<std::uint32_t>(data.size()),
+            };
+
+            append_binary_cache(bytes, &record, sizeof(record));
+            append_binary_cache(bytes, data.data(), data.size());
+        }
+
+        // Calls the function with every valid record of a journal of the given version and algorithm, returns the size
+        // of the valid part of the journal, or zero if the journal is not one of the cache.
+        template <typename func_t>
+        std::size_t read_binary_journal(const std::span<const std::uint8_t> bytes, const std::string_view version, const hashes::hash_algorithm algorithm, func_t&& func)
+        {
+            binary_journal_header header;
+            if (bytes.size() < sizeof(binary_journal_header))
+            {
+                return 0;
+            }
+
+            std::memcpy(&header, bytes.data(), sizeof(binary_journal_header));
+
+            if (header.magic != binary_journal_magic || header.format != binary_journal_format || header.byte_order != 0x01020304)
+            {
+                return 0;
+            }
+
+            const std::size_t version_offset = sizeof(binary_journal_header);
+            const std::string_view header_version {reinterpret_cast<const char*>(bytes.data()) + version_offset, std::min<std::size_t>(header.version_size, bytes.size() - version_offset)};
+
+            if (header.algorithm != static_cast<std::uint32_t>(algorithm) || header_version != version)
+            {
+                return 0;
+            }
+
+            std::size_t offset = version_offset + header.version_size;
+
+            while (bytes.size() - offset >= sizeof(binary_journal_record))
+            {
+                binary_journal_record record;
+                std::memcpy(&record, bytes.data() + offset, sizeof(binary_journal_record));
+
+                const std::span<const std::uint8_t> data = bytes.subspan(offset + sizeof(binary_journal_record));
+
+                if (data.size() < record.size || XXH3_64bits(data.data(), record.size) != record.checksum)
+                {
+                    break;
+                }
+
+                try
+                {
+                    func(nlohmann::json::from_cbor(data.begin(), data.begin() + record.size));
+                }
+                catch (const std::exception&)
+                {
+                    break;
+                }
+
+                offset += sizeof(binary_journal_record) + record.size;
+            }
+
+            return offset;
+        }
+    }
+
+    // Cache of the inputs of the previous run. The cache is stored in a binary format that is looked up in place,
+    // unless its file has a JSON, BSON or YAML extension, which is meant for debugging. Binary caches are updated by
+    // appending the entries that changed to a journal next to the cache file, which is compacted into the cache file
+    // once it grows large compared to it. Runs sharing a cache file, e.g. codegen targets built in parallel, only lock
+    // it while they write to it, and take in what the other runs wrote before they do.
+    struct codegen_cache
+    {
+        using entries_t = std::unordered_map<std::string, codegen_cache_entry, detail::cache_string_hash, std::equal_to<>>;
+
+        std::string version = SPORE_CODEGEN_VERSION;
+        hashes::hash_algorithm algorithm = hashes::hash_algorithm::xxh3;
 
         [[nodiscard]] bool empty() const
         {
-            return entries.empty();
+            return _entries.empty() && _previous_entries.empty() && _previous_view.size() == 0;
+        }
+
+        // Entries checked during this run take precedence over the ones of the previous run.
+        [[nodiscard]] std::optional<codegen_cache_entry> find(const std::string_view file) const
+        {
+            if (const auto it_entry = _entries.find(file); it_entry != _entries.end())
+            {
+                return it_entry->second;
+            }
+
+            if (const auto it_entry = _previous_entries.find(file); it_entry != _previous_entries.end())
+            {
+                return it_entry->second;
+            }
+
+            return _previous_view.find(file);
+        }
+
+        [[nodiscard]] std::optional<std::string> find_fingerprint(const std::string_view name) const
+        {
+            if (const auto it_fingerprint = _fingerprints.find(name); it_fingerprint != _fingerprints.end())
+            {
+                return it_fingerprint->second;
+            }
+
+            if (const auto it_fingerprint = _previous_fingerprints.find(name); it_fingerprint != _previous_fingerprints.end())
+            {
+                return it_fingerprint->second;
+            }
+
+            return std::nullopt;
+        }
+
+        // Fingerprints are digests of what results depend on other than files, e.g. the config of a stage, by name.
+        void update_fingerprint(const std::string_view name, std::string hash)
+        {
+            if (find_fingerprint(name) != hash)
+            {
+                _journal_fingerprints.emplace_back(name);
+                _fingerprints.insert_or_assign(std::string(name), std::move(hash));
+            }
         }
 
         [[nodiscard]] codegen_cache_status check_and_update(const std::string_view file)
         {
+            const std::optional<codegen_cache_entry> entry = find(file);
+            return update(check(file, entry.has_value() ? &entry.value() : nullptr, algorithm));
+        }
+
+        // Checks a file against its previous entry without touching the cache, so that many files can be checked
+        // concurrently. The result is recorded with `update`.
+        [[nodiscard]] static codegen_cache_check check(const std::string_view file, const codegen_cache_entry* entry, const hashes::hash_algorithm algorithm)
+        {
+            codegen_cache_check check {
+                .file = std::string(file),
+                .status = codegen_cache_status::dirty,
+            };
+
+            files::file_stat stat;
+            if (!files::stat_file(file, stat))
+            {
+                return check;
+            }
+
+            // Files whose metadata did not change are not hashed again.
+            if (entry != nullptr && is_stat_unchanged(*entry, stat))
+            {
+                check.status = codegen_cache_status::up_to_date;
+                check.entry = *entry;
+                return check;
+            }
+
             std::string hash;
-            if (!files::hash_file(file, hash))
+            if (!files::hash_file(file, algorithm, hash))
             {
-                return codegen_cache_status::dirty;
+                return check;
             }
 
-            const std::size_t file_size = std::filesystem::file_size(file);
-            const auto make_entry = [&] {
-                return codegen_cache_entry {
-                    .file = std::string(file),
-                    .hash = std::move(hash),
-                    .size = file_size,
-                };
+            if (entry == nullptr)
+            {
+                check.status = codegen_cache_status::new_;
+            }
+            else
+            {
+                const bool is_entry_dirty = stat.size != entry->size || hash != entry->hash;
+                check.status = is_entry_dirty ? codegen_cache_status::dirty : codegen_cache_status::up_to_date;
+            }
+
+            // The entry is replaced even if the content is the same, so that the new metadata is used next time.
+            check.entry = codegen_cache_entry {
+                .file = check.file,
+                .hash = std::move(hash),
+                .size = stat.size,
+                .mtime = is_stat_recent(stat) ? 0 : stat.mtime,
+                .ctime = stat.ctime,
+                .inode = stat.inode,
             };
 
-            const auto it_entry = entries.find(file);
+            // Dependencies are only known by parsing the file and outputs by rendering it, they are kept until then.
+            if (entry != nullptr)
+            {
+                check.entry->dependencies = entry->dependencies;
+                check.entry->outputs = entry->outputs;
+                check.entry->key = entry->key;
+                check.entry->output_hash = entry->output_hash;
+            }
+
+            return check;
+        }
 
-            if (it_entry == entries.end())
+        codegen_cache_status update(codegen_cache_check check)
+        {
+            if (check.entry.has_value())
             {
-                entries.emplace(make_entry());
-                return codegen_cache_status::new_;
+                if (find(check.file) != check.entry)
+                {
+                    _journal_files.emplace_back(check.file);
+                }
+
+                _entries.insert_or_assign(std::move(check.file), std::move(check.entry.value()));
             }
 
-            const bool is_entry_dirty = file_size != it_entry->size || hash != it_entry->hash;
+            return check.status;
+        }
+
+        // Outputs are recorded along with the key they were rendered from and the hash of their content, their
+        // metadata is kept as is, so that the output is still found changed when it is checked as an input of another
+        // stage.
+        void update_output(const std::string_view file, std::string key, std::string output_hash)
+        {
+            auto it_entry = _entries.find(file);
+
+            if (it_entry == _entries.end())
+            {
+                codegen_cache_entry entry = find(file).value_or(codegen_cache_entry {.file = std::string(file)});
+                it_entry = _entries.emplace(std::string(file), std::move(entry)).first;
+            }
+
+            if (it_entry->second.key != key || it_entry->second.output_hash != output_hash)
+            {
+                it_entry->second.key = std::move(key);
+                it_entry->second.output_hash = std::move(output_hash);
+                _journal_files.emplace_back(file);
+            }
+        }
+
+        // Outputs can only be set on files checked during this run.
+        bool update_outputs(const std::string_view file, std::vector<std::string> outputs)
+        {
+            const auto it_entry = _entries.find(file);
+
+            if (it_entry == _entries.end())
+            {
+                return false;
+            }
 
-            if (is_entry_dirty)
+            if (it_entry->second.outputs != outputs)
             {
-                entries.erase(it_entry);
-                entries.emplace(make_entry());
-                return codegen_cache_status::dirty;
+                it_entry->second.outputs = std::move(outputs);
+                _journal_files.emplace_back(file);
             }
 
-            return codegen_cache_status::up_to_date;
+            return true;
         }
 
-        void reset()
+        // Dependencies can only be set on files checked during this run.
+        bool update_dependencies(const std::string_view file, std::vector<std::string> dependencies)
+        {
+            const auto it_entry = _entries.find(file);
+
+            if (it_entry == _entries.end())
+            {
+                return false;
+            }
+
+            if (it_entry->second.dependencies != dependencies)
+            {
+                it_entry->second.dependencies = std::move(dependencies);
+                _journal_files.emplace_back(file);
+            }
+
+            return true;
+        }
+
+        void reset(const hashes::hash_algorithm new_algorithm)
         {
             version = SPORE_CODEGEN_VERSION;
-            entries.clear();
+            algorithm = new_algorithm;
+            clear();
+            _has_journal_base = false;
+            _is_merged = false;
+            _base_stat = std::nullopt;
+            _journal_stat = std::nullopt;
+        }
+
+        // Entries written by other runs sharing the cache file after it was read are merged when it is written, while
+        // entries of this run take precedence.
+        bool read(const std::string_view path)
+        {
+            file_lock lock;
+            std::ignore = lock.lock(current_path_scope::absolute(detail::get_lock_path(path)));
+
+            _is_merged = true;
+            return load(path);
+        }
+
+        // Entries checked during this run are written, along with the entries of the previous run whose file still
+        // exists, files that were deleted are pruned. The journal is removed first, so that it never applies to another
+        // cache file than the one it was appended to.
+        bool write(const std::string_view path)
+        {
+            file_lock lock;
+            std::ignore = lock.lock(current_path_scope::absolute(detail::get_lock_path(path)));
+            refresh(path);
+
+            std::vector<codegen_cache_entry> entries;
+            entries.reserve(_entries.size());
+
+            for (const auto& [file, entry] : _entries)
+            {
+                entries.emplace_back(entry);
+            }
+
+            const auto add_previous_entry = [&](const codegen_cache_entry& entry) {
+                files::file_stat stat;
+                if (!_entries.contains(entry.file) && files::stat_file(entry.file, stat))
+                {
+                    entries.emplace_back(entry);
+                }
+            };
+
+            for (const auto& [file, entry] : _previous_entries)
+            {
+                add_previous_entry(entry);
+            }
+
+            _previous_view.for_each([&](const codegen_cache_entry& entry) {
+                if (!_previous_entries.contains(entry.file))
+                {
+                    add_previous_entry(entry);
+                }
+            });
+
+            // Entries are sorted so that the same inputs always give the same cache.
+            std::ranges::sort(entries, std::less<>(), &codegen_cache_entry::file);
+
+            detail::cache_fingerprints_t fingerprints = _fingerprints;
+            fingerprints.insert(_previous_fingerprints.begin(), _previous_fingerprints.end());
+
+            std::error_code error;
+            std::filesystem::remove(current_path_scope::absolute(detail::get_journal_path(path)), error);
+            _journal_size = 0;
+            _journal_count = 0;
+
+            bool written;
+
+            if (files::detail::get_json_type(path) != files::detail::json_file_type::none)
+            {
+                nlohmann::json json;
+                json["version"] = SPORE_CODEGEN_VERSION;
+                json["algorithm"] = algorithm;
+                json["entries"] = entries;
+
+                for (const auto& [name, hash] : fingerprints)
+                {
+                    json["fingerprints"][name] = hashes::to_hex(hash);
+                }
+
+                written = files::write_file(path, json);
+            }
+            else
+            {
+                written = files::write_file(path, detail::make_binary_cache(SPORE_CODEGEN_VERSION, algorithm, entries, fingerprints));
+            }
+
+            if (written)
+            {
+                _journal_files.clear();
+                _journal_fingerprints.clear();
+                _has_journal_base = true;
+                _base_stat = stat_cache_file(path);
+                _journal_stat = std::nullopt;
+            }
+
+            return written;
+        }
+
+        // Appends entries and fingerprints updated since the last flush to the journal, entries of files rejected by the
+        // predicate are kept for a later flush, e.g. until every stage reading them completed. Caches in text formats
+        // are only ever written whole.
+        template <typename predicate_t>
+        bool flush(const std::string_view path, predicate_t&& predicate)
+        {
+            if (files::detail::get_json_type(path) != files::detail::json_file_type::none)
+            {
+                return true;
+            }
+
+            std::ranges::sort(_journal_files);
+            _journal_files.erase(std::ranges::unique(_journal_files).begin(), _journal_files.end());
+
+            std::vector<std::string> held_files;
+            std::vector<std::uint8_t> records;
+            std::size_t record_count = 0;
+
+            for (std::string& file : _journal_files)
+            {
+                if (!predicate(std::as_const(file)))
+                {
+                    held_files.emplace_back(std::move(file));
+                    continue;
+                }
+
+                detail::append_binary_journal_record(records, nlohmann::json(_entries.at(file)));
+                ++record_count;
+            }
+
+            _journal_files = std::move(held_files);
+
+            std::ranges::sort(_journal_fingerprints);
+            _journal_fingerprints.erase(std::ranges::unique(_journal_fingerprints).begin(), _journal_fingerprints.end());
+
+            for (const std::string& name : _journal_fingerprints)
+            {
+                const nlohmann::json fingerprint_json {
+                    {"fingerprint", name},
+                    {"hash", hashes::to_hex(_fingerprints.at(name))},
+                };
+
+                detail::append_binary_journal_record(records, fingerprint_json);
+                ++record_count;
+            }
+
+            _journal_fingerprints.clear();
+
+            if (record_count == 0)
+            {
+                return true;
+            }
+
+            // Records of other runs appended since the last flush are kept, the journal is only ever appended to.
+            file_lock lock;
+            std::ignore = lock.lock(current_path_scope::absolute(detail::get_lock_path(path)));
+            refresh(path);
+
+            // A journal only applies to the cache file it was started with, a cache that was not read from its file,
+            // or that was reset since, starts from an empty one.
+            if (!_has_journal_base && !write_empty(path))
+            {
+                return false;
+            }
+
+            const std::filesystem::path journal_path = current_path_scope::absolute(detail::get_journal_path(path));
+            std::error_code error;
+            std::vector<std::uint8_t> bytes;
+
+            if (_journal_size == 0)
+            {
+                detail::append_binary_journal_header(bytes, version, algorithm);
+            }
+            else
+            {
+                // Records torn by an interrupted run are dropped, they would hide every record appended after them.
+                std::filesystem::resize_file(journal_path, _journal_size, error);
+
+                if (error)
+                {
+                    return false;
+                }
+            }
+
+            bytes.insert(bytes.end(), records.begin(), records.end());
+
+            std::ofstream stream(journal_path, std::ios::out | std::ios::binary | (_journal_size == 0 ? std::ios::trunc : std::ios::app));
+            stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            stream.close();
+
+            if (stream.fail())
+            {
+                return false;
+            }
+
+            _journal_size += bytes.size();
+            _journal_count += record_count;
+            _journal_stat = stat_cache_file(detail::get_journal_path(path));
+            return true;
+        }
+
+        // Flushes every updated entry, the journal is compacted into the cache file once it holds more records than a
+        // fraction of the entries of the cache file, so that runs that update few entries only write these.
+        bool save(const std::string_view path)
+        {
+            constexpr std::size_t min_compaction_count = 64;
+
+            if (!flush(path, [](const std::string&) { return true; }))
+            {
+                return false;
+            }
+
+            const std::size_t compaction_count = std::max(min_compaction_count, _previous_view.size() / 4);
+            return (_has_journal_base && _journal_count < compaction_count) || write(path);
+        }
+
+      private:
+        entries_t _entries;
+        entries_t _previous_entries;
+        detail::binary_cache_view _previous_view;
+        detail::cache_fingerprints_t _fingerprints;
+        detail::cache_fingerprints_t _previous_fingerprints;
+        std::vector<std::string> _journal_files;
+        std::vector<std::string> _journal_fingerprints;
+        std::size_t _journal_size = 0;
+        std::size_t _journal_count = 0;
+        bool _has_journal_base = false;
+        bool _is_merged = false;
+        std::optional<files::file_stat> _base_stat;
+        std::optional<files::file_stat> _journal_stat;
+
+        static std::optional<files::file_stat> stat_cache_file(const std::string_view path)
+        {
+            files::file_stat stat;
+            return files::stat_file(path, stat) ? std::optional {stat} : std::nullopt;
+        }
+
+        bool load(const std::string_view path)
+        {
+            // Files are stat'ed before they are read, a file replaced in between is only read again on the next write.
+            const std::optional<files::file_stat> base_stat = stat_cache_file(path);
+            const std::optional<files::file_stat> journal_stat = stat_cache_file(detail::get_journal_path(path));
+
+            if (files::detail::get_json_type(path) != files::detail::json_file_type::none)
+            {
+                nlohmann::json json;
+                if (!files::read_file(path, json))
+                {
+                    return false;
+                }
+
+                from_json(json);
+                _base_stat = base_stat;
+                return true;
+            }
+
+            mapped_file file;
+            if (!file.open(current_path_scope::absolute(path)))
+            {
+                return false;
+            }
+
+            // Caches that cannot be read, e.g. of another format or truncated, are treated as missing.
+            detail::binary_cache_view view;
+            const std::optional<hashes::hash_algorithm> view_algorithm = view.open(std::move(file)) ? detail::to_hash_algorithm(view.algorithm()) : std::nullopt;
+
+            if (!view_algorithm.has_value())
+            {
+                return false;
+            }
+
+            version = view.version();
+            algorithm = view_algorithm.value();
+            clear();
+            _previous_view = std::move(view);
+            _has_journal_base = true;
+            _base_stat = base_stat;
+            _journal_stat = journal_stat;
+
+            _previous_view.for_each_fingerprint([&](const std::string_view name, const std::string_view hash) {
+                _previous_fingerprints.insert_or_assign(std::string(name), std::string(hash));
+            });
+
+            // Records of the journal take precedence over the ones of the cache file.
+            mapped_file journal_file;
+            if (journal_file.open(current_path_scope::absolute(detail::get_journal_path(path))))
+            {
+                const auto add_journal_record = [&](const nlohmann::json& json) {
+                    if (json.contains("fingerprint"))
+                    {
+                        std::string name;
+                        std::string hash;
+                        json::get_checked(json, "fingerprint", name, detail::cache_context);
+                        json::get_checked(json, "hash", hash, detail::cache_context);
+
+                        if (!hashes::from_hex(hash, _previous_fingerprints[name]))
+                        {
+                            throw codegen_error(codegen_error_code::invalid, "invalid fingerprint hash, fingerprint={} hash={}", name, hash);
+                        }
+                    }
+                    else
+                    {
+                        codegen_cache_entry entry = json;
+                        std::string file = entry.file;
+                        _previous_entries.insert_or_assign(std::move(file), std::move(entry));
+                    }
+
+                    ++_journal_count;
+                };
+
+                _journal_size = detail::read_binary_journal(journal_file.bytes(), version, algorithm, add_journal_record);
+            }
+
+            return true;
+        }
+
+        void clear()
+        {
+            _entries.clear();
+            _previous_entries.clear();
+            _previous_view = {};
+            _fingerprints.clear();
+            _previous_fingerprints.clear();
+            _journal_files.clear();
+            _journal_fingerprints.clear();
+            _journal_size = 0;
+            _journal_count = 0;
+        }
+
+        bool write_empty(const std::string_view path)
+        {
+            std::error_code error;
+            std::filesystem::remove(current_path_scope::absolute(detail::get_journal_path(path)), error);
+            _journal_size = 0;
+            _journal_count = 0;
+
+            if (!files::write_file(path, detail::make_binary_cache(version, algorithm, {}, {})))
+            {
+                return false;
+            }
+
+            _has_journal_base = true;
+            _base_stat = stat_cache_file(path);
+            _journal_stat = std::nullopt;
+            return true;
+        }
+
+        // Takes in what other runs sharing the cache file wrote since this run last read or wrote it, with the lock
+        // held. Caches that were reset rather than read keep their entries to themselves, but still append to the
+        // journal of other runs instead of replacing it. A cache file of another version or algorithm is replaced.
+        void refresh(const std::string_view path)
+        {
+            if (stat_cache_file(path) == _base_stat && stat_cache_file(detail::get_journal_path(path)) == _journal_stat)
+            {
+                return;
+            }
+
+            codegen_cache other_cache;
+
+            if (!other_cache.load(path) || other_cache.version != version || other_cache.algorithm != algorithm)
+            {
+                _has_journal_base = false;
+                _journal_size = 0;
+                _journal_count = 0;
+                _base_stat = std::nullopt;
+                _journal_stat = std::nullopt;
+                return;
+            }
+
+            _has_journal_base = other_cache._has_journal_base;
+            _journal_size = other_cache._journal_size;
+            _journal_count = other_cache._journal_count;
+            _base_stat = other_cache._base_stat;
+            _journal_stat = other_cache._journal_stat;
+
+            if (_is_merged)
+            {
+                _previous_entries = std::move(other_cache._previous_entries);
+                _previous_view = std::move(other_cache._previous_view);
+                _previous_fingerprints = std::move(other_cache._previous_fingerprints);
+            }
+        }
+
+        void from_json(const nlohmann::json& json);
+
+        static bool is_stat_unchanged(const codegen_cache_entry& entry, const files::file_stat& stat)
+        {
+            return entry.mtime != 0 && entry.size == stat.size && entry.mtime == stat.mtime && entry.ctime == stat.ctime && entry.inode == stat.inode;
+        }
+
+        static bool is_stat_recent(const files::file_stat& stat)
+        {
+            // A file modified within the timestamp resolution of its file system could be modified again without its
+            // modification time changing. Such files are recorded without a modification time, so that they are hashed
+            // on the next run, like git does for racily clean files.
+            constexpr std::int64_t racy_window = 2'000'000'000;
+
+            const auto now = std::chrono::system_clock::now().time_since_epoch();
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() - stat.mtime < racy_window;
         }
     };
 
-    namespace detail
+    inline void codegen_cache::from_json(const nlohmann::json& json)
     {
-        constexpr std::string_view cache_context = "cache";
-    }
+        std::vector<codegen_cache_entry> entries;
 
-    inline void to_json(nlohmann::json& json, const codegen_cache_entry& value)
-    {
-        json["file"] = value.file;
-        json["hash"] = value.hash;
-        json["size"] = value.size;
-    }
+        json::get_checked(json, "version", version, detail::cache_context);
 
-    inline void from_json(const nlohmann::json& json, codegen_cache_entry& value)
-    {
-        json::get_checked(json, "file", value.file, detail::cache_context);
-        json::get_checked(json, "hash", value.hash, detail::cache_context);
-        json::get_checked(json, "size", value.size, detail::cache_context);
-    }
+        // Caches written before the algorithm was configurable are SHA-256.
+        json::get_opt(json, "algorithm", algorithm, hashes::hash_algorithm::sha256);
+        json::get_checked(json, "entries", entries, detail::cache_context);
 
-    inline void to_json(nlohmann::json& json, const codegen_cache& value)
-    {
-        json["version"] = SPORE_CODEGEN_VERSION;
-        json["entries"] = value.entries;
-    }
+        clear();
+        _has_journal_base = false;
 
-    inline void from_json(const nlohmann::json& json, codegen_cache& value)
-    {
-        json::get_checked(json, "version", value.version, detail::cache_context);
-        json::get_checked(json, "entries", value.entries, detail::cache_context);
+        for (codegen_cache_entry& entry : entries)
+        {
+            std::string file = entry.file;
+            _previous_entries.insert_or_assign(std::move(file), std::move(entry));
+        }
+
+        std::map<std::string, std::string> fingerprints;
+        json::get_opt(json, "fingerprints", fingerprints);
+
+        for (const auto& [name, hash] : fingerprints)
+        {
+            if (!hashes::from_hex(hash, _previous_fingerprints[name]))
+            {
+                throw codegen_error(codegen_error_code::invalid, "invalid fingerprint hash, fingerprint={} hash={}", name, hash);
+            }
+        }
     }
 
     inline void to_json(nlohmann::json& json, const codegen_cache_status& value)
@@ -148,4 +1322,4 @@ namespace spore::codegen
             json = it_value->second;
         }
     }
-}
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_set>
 #include <vector>
 
 #include "nlohmann/json.hpp"
@@ -27,7 +29,9 @@ namespace spore::codegen
         std::string directory;
         std::string parser;
         std::vector<std::string> files;
+        std::vector<std::string> markers;
         std::vector<codegen_config_step> steps;
+        std::optional<std::vector<std::string>> dependencies;
     };
 
     struct codegen_config
@@ -71,6 +75,33 @@ namespace spore::codegen
         {
             files.get_to(value.files);
         }
+
+        nlohmann::json markers;
+        json::get_opt(json, "markers", markers);
+
+        if (markers.is_string())
+        {
+            markers.get_to(value.markers.emplace_back());
+        }
+        else if (markers.is_array())
+        {
+            markers.get_to(value.markers);
+        }
+
+        nlohmann::json dependencies;
+        if (json::get(json, "dependencies", dependencies))
+        {
+            std::vector<std::string>& value_dependencies = value.dependencies.emplace();
+
+            if (dependencies.is_string())
+            {
+                dependencies.get_to(value_dependencies.emplace_back());
+            }
+            else if (dependencies.is_array())
+            {
+                dependencies.get_to(value_dependencies);
+            }
+        }
     }
 
     inline void from_json(const nlohmann::json& json, codegen_config& value)
@@ -89,5 +120,16 @@ namespace spore::codegen
                 throw codegen_error(codegen_error_code::configuring, "unknown configuration version {}", version);
             }
         }
+
+        // Stages are referred to by name, by their dependencies and by the cache, names must then be unique.
+        std::unordered_set<std::string_view> names;
+
+        for (const codegen_config_stage& stage : value.stages)
+        {
+            if (!names.emplace(stage.name).second)
+            {
+                throw codegen_error(codegen_error_code::configuring, "duplicate stage name, stage={}", stage.name);
+            }
+        }
     }
 }
\ No newline at end of file
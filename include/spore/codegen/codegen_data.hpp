@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "nlohmann/json.hpp"
@@ -22,6 +23,10 @@ namespace spore::codegen
     {
         std::string path;
         codegen_cache_status status = codegen_cache_status::new_;
+        std::vector<std::size_t> include_indices;
+
+        // Digest of the template and of every template it includes.
+        std::string hash;
     };
 
     struct codegen_file_data
@@ -35,18 +40,26 @@ namespace spore::codegen
     {
         std::vector<std::size_t> template_indices;
         std::optional<nlohmann::json> condition;
+        codegen_cache_status status = codegen_cache_status::new_;
+
+        // Digest of the config of the step and of the user data.
+        std::string hash;
     };
 
     struct codegen_stage_data
     {
         std::vector<codegen_file_data> files;
         std::vector<codegen_step_data> steps;
+
+        // Digest of the config of the stage and of the arguments of its parser.
+        std::string hash;
     };
 
     struct codegen_data
     {
         std::vector<lazy<codegen_stage_data>> stages;
         std::vector<codegen_template_data> templates;
+        std::unordered_map<std::string, std::size_t> template_indices;
     };
 
     inline void to_json(nlohmann::json& json, const codegen_output_data& value)
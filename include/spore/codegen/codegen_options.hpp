@@ -6,14 +6,19 @@
 
 #include "nlohmann/json.hpp"
 
+#include "spore/codegen/utils/hashes.hpp"
+
 namespace spore::codegen
 {
     struct codegen_options
     {
         std::string config;
         std::string cache;
+        std::string artifact_cache;
         std::vector<std::string> templates;
         std::vector<std::pair<std::string, nlohmann::json>> user_data;
+        std::size_t jobs = 1;
+        hashes::hash_algorithm hash = hashes::hash_algorithm::xxh3;
         bool reformat : 1 = false;
         bool force : 1 = false;
         bool debug : 1 = false;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <string_view>
 
@@ -10,5 +11,14 @@ namespace spore::codegen
         virtual ~codegen_formatter() = default;
         [[nodiscard]] virtual bool can_format_file(const std::string_view file) const = 0;
         [[nodiscard]] virtual bool format_file(const std::string_view file, std::string& file_data) = 0;
+
+        // Everything other than the data of a file that its formatted data depends on, e.g. the style it is formatted
+        // with. Outputs formatted with another fingerprint are never reused.
+        [[nodiscard]] virtual std::string fingerprint(const std::string_view)
+        {
+            return {};
+        }
+
+        [[nodiscard]] virtual std::unique_ptr<codegen_formatter> clone() const = 0;
     };
 }
\ No newline at end of file
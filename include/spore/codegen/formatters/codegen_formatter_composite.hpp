@@ -19,6 +19,18 @@ namespace spore::codegen
             (formatters.emplace_back(std::move(formatters_)), ...);
         }
 
+        codegen_formatter_composite(const codegen_formatter_composite& other)
+        {
+            formatters.reserve(other.formatters.size());
+
+            for (const std::unique_ptr<codegen_formatter>& formatter : other.formatters)
+            {
+                formatters.emplace_back(formatter->clone());
+            }
+        }
+
+        codegen_formatter_composite(codegen_formatter_composite&&) noexcept = default;
+
         bool can_format_file(const std::string_view file) const override
         {
             const auto predicate = [&](const std::unique_ptr<codegen_formatter>& formatter) {
@@ -44,5 +56,20 @@ namespace spore::codegen
 
             return false;
         }
+
+        std::string fingerprint(const std::string_view file) override
+        {
+            const auto predicate = [&](const std::unique_ptr<codegen_formatter>& formatter) {
+                return formatter->can_format_file(file);
+            };
+
+            const auto it_formatter = std::ranges::find_if(formatters, predicate);
+            return it_formatter != formatters.end() ? (*it_formatter)->fingerprint(file) : std::string {};
+        }
+
+        std::unique_ptr<codegen_formatter> clone() const override
+        {
+            return std::make_unique<codegen_formatter_composite>(*this);
+        }
     };
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <functional>
+#include <map>
+#include <string>
+
 #include "spore/codegen/formatters/codegen_formatter.hpp"
 
 namespace spore::codegen
@@ -8,5 +12,11 @@ namespace spore::codegen
     {
         bool can_format_file(const std::string_view file) const override;
         bool format_file(const std::string_view file, std::string& file_data) override;
+        std::string fingerprint(const std::string_view file) override;
+        std::unique_ptr<codegen_formatter> clone() const override;
+
+      private:
+        // Styles are found once per directory and per instance, each thread has its own instance.
+        std::map<std::string, std::string, std::less<>> _fingerprints;
     };
 }
\ No newline at end of file
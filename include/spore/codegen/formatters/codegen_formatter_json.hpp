@@ -29,5 +29,10 @@ namespace spore::codegen
             file_data = json.dump(indent);
             return true;
         }
+
+        std::unique_ptr<codegen_formatter> clone() const override
+        {
+            return std::make_unique<codegen_formatter_json>(*this);
+        }
     };
 }
\ No newline at end of file
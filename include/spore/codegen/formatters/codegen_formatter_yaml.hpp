@@ -40,5 +40,10 @@ namespace spore::codegen
 
             return true;
         }
+
+        std::unique_ptr<codegen_formatter> clone() const override
+        {
+            return std::make_unique<codegen_formatter_yaml>(*this);
+        }
     };
 }
\ No newline at end of file
@@ -1,22 +1,25 @@
 #pragma once
 
 #include <filesystem>
+#include <utility>
 
 namespace spore::codegen
 {
+    // Working directory of the current thread. The process working directory is shared by every thread, so
+    // it is never changed; relative paths are resolved against this scope through `absolute` instead.
     struct current_path_scope
     {
         std::filesystem::path old_path;
 
         explicit current_path_scope(const std::filesystem::path& new_path)
         {
-            old_path = std::filesystem::current_path();
-            std::filesystem::current_path(new_path);
+            std::filesystem::path path = std::filesystem::weakly_canonical(absolute(new_path));
+            old_path = std::exchange(_current_path, std::move(path));
         }
 
         ~current_path_scope()
         {
-            std::filesystem::current_path(old_path);
+            _current_path = std::move(old_path);
         }
 
         current_path_scope(const current_path_scope&) = delete;
@@ -24,5 +27,18 @@ namespace spore::codegen
 
         current_path_scope& operator=(const current_path_scope&) = delete;
         current_path_scope& operator=(current_path_scope&&) = delete;
+
+        static std::filesystem::path current_path()
+        {
+            return _current_path.empty() ? std::filesystem::current_path() : _current_path;
+        }
+
+        static std::filesystem::path absolute(const std::filesystem::path& path)
+        {
+            return path.is_absolute() ? path : current_path() / path;
+        }
+
+      private:
+        static inline thread_local std::filesystem::path _current_path;
     };
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cerrno>
+#include <filesystem>
+#include <utility>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/file.h>
+#    include <unistd.h>
+#endif
+
+namespace spore::codegen
+{
+    // Exclusive advisory lock on a file, shared by every process that locks the same file, e.g. concurrent codegen
+    // runs of the same build. The file is created if it does not exist and is never removed, since removing it would
+    // let two processes lock different files of the same name.
+    struct file_lock
+    {
+        file_lock() = default;
+
+        ~file_lock()
+        {
+            unlock();
+        }
+
+        file_lock(const file_lock&) = delete;
+        file_lock(file_lock&&) = delete;
+
+        file_lock& operator=(const file_lock&) = delete;
+        file_lock& operator=(file_lock&&) = delete;
+
+        // Blocks until the lock is acquired. Locks cannot be nested within a process, the lock of another file
+        // description of the same file is waited on like the lock of another process.
+        bool lock(const std::filesystem::path& path)
+        {
+            unlock();
+
+#if !defined(_WIN32)
+            _descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (_descriptor < 0)
+            {
+                return false;
+            }
+
+            while (::flock(_descriptor, LOCK_EX) != 0)
+            {
+                if (errno != EINTR)
+                {
+                    unlock();
+                    return false;
+                }
+            }
+
+            return true;
+#else
+            _handle = ::CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (_handle == INVALID_HANDLE_VALUE)
+            {
+                _handle = nullptr;
+                return false;
+            }
+
+            OVERLAPPED overlapped {};
+            if (!::LockFileEx(_handle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped))
+            {
+                ::CloseHandle(std::exchange(_handle, nullptr));
+                return false;
+            }
+
+            return true;
+#endif
+        }
+
+        void unlock()
+        {
+#if !defined(_WIN32)
+            if (_descriptor >= 0)
+            {
+                ::close(std::exchange(_descriptor, -1));
+            }
+#else
+            if (_handle != nullptr)
+            {
+                OVERLAPPED overlapped {};
+                ::UnlockFileEx(_handle, 0, MAXDWORD, MAXDWORD, &overlapped);
+                ::CloseHandle(std::exchange(_handle, nullptr));
+            }
+#endif
+        }
+
+      private:
+#if !defined(_WIN32)
+        int _descriptor = -1;
+#else
+        HANDLE _handle = nullptr;
+#endif
+    };
+}
\ No newline at end of file
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "spore/codegen/codegen_error.hpp"
+#include "spore/codegen/misc/current_path_scope.hpp"
+#include "spore/codegen/utils/files.hpp"
+
+namespace spore::codegen
+{
+    // Writes files on a dedicated thread, so that producers only wait on the file system when the queue is full.
+    // Queued writes are drained in batches.
+    struct file_writer
+    {
+      private:
+        struct group_state;
+
+      public:
+        // Writes of a single producer, e.g. a stage. Waiting on a group reports the first failure of its own writes.
+        struct group
+        {
+            explicit group(file_writer& writer)
+                : _writer(writer),
+                  _state(std::make_shared<group_state>())
+            {
+            }
+
+            ~group()
+            {
+                // Pending writes are completed before the group goes away, failures are only reported by `wait`.
+                try
+                {
+                    wait();
+                }
+                catch (...)
+                {
+                }
+            }
+
+            group(const group&) = delete;
+            group(group&&) = delete;
+
+            group& operator=(const group&) = delete;
+            group& operator=(group&&) = delete;
+
+            void write(const std::string& path, std::string content)
+            {
+                _writer.enqueue(_state, current_path_scope::absolute(path).string(), std::move(content));
+            }
+
+            void wait()
+            {
+                std::unique_lock lock {_state->mutex};
+                _state->condition.wait(lock, [&] { return _state->pending == 0; });
+
+                if (const std::optional<std::string> failed_path = std::exchange(_state->failed_path, std::nullopt))
+                {
+                    throw codegen_error(codegen_error_code::io, "failed to write output, file={}", failed_path.value());
+                }
+            }
+
+          private:
+            file_writer& _writer;
+            std::shared_ptr<group_state> _state;
+        };
+
+        explicit file_writer(const std::size_t capacity = 256)
+            : _capacity(capacity),
+              _thread([this] { run(); })
+        {
+        }
+
+        ~file_writer()
+        {
+            {
+                std::scoped_lock lock {_mutex};
+                _stopping = true;
+            }
+
+            _not_empty.notify_all();
+            _thread.join();
+        }
+
+        file_writer(const file_writer&) = delete;
+        file_writer(file_writer&&) = delete;
+
+        file_writer& operator=(const file_writer&) = delete;
+        file_writer& operator=(file_writer&&) = delete;
+
+      private:
+        struct group_state
+        {
+            std::size_t pending = 0;
+            std::optional<std::string> failed_path;
+            std::mutex mutex;
+            std::condition_variable condition;
+        };
+
+        struct write_request
+        {
+            std::shared_ptr<group_state> state;
+            std::string path;
+            std::string content;
+        };
+
+        std::size_t _capacity;
+        std::deque<write_request> _requests;
+        std::mutex _mutex;
+        std::condition_variable _not_empty;
+        std::condition_variable _not_full;
+        bool _stopping = false;
+        std::thread _thread;
+
+        void enqueue(const std::shared_ptr<group_state>& state, std::string path, std::string content)
+        {
+            {
+                std::scoped_lock lock {state->mutex};
+                ++state->pending;
+            }
+
+            {
+                std::unique_lock lock {_mutex};
+                _not_full.wait(lock, [&] { return _requests.size() < _capacity; });
+                _requests.push_back({state, std::move(path), std::move(content)});
+            }
+
+            _not_empty.notify_one();
+        }
+
+        void run()
+        {
+            while (true)
+            {
+                std::vector<write_request> requests;
+
+                {
+                    std::unique_lock lock {_mutex};
+                    _not_empty.wait(lock, [&] { return _stopping || !_requests.empty(); });
+
+                    if (_requests.empty())
+                    {
+                        return;
+                    }
+
+                    requests.assign(std::make_move_iterator(_requests.begin()), std::make_move_iterator(_requests.end()));
+                    _requests.clear();
+                }
+
+                _not_full.notify_all();
+
+                for (write_request& request : requests)
+                {
+                    write(request);
+                }
+            }
+        }
+
+        static void write(write_request& request)
+        {
+            bool changed = false;
+            bool written = false;
+
+            try
+            {
+                written = files::write_file_if_changed(request.path, request.content, changed);
+            }
+            catch (...)
+            {
+            }
+
+            if (written && !changed)
+            {
+                SPDLOG_DEBUG("output unchanged, write skipped, file={}", request.path);
+            }
+
+            {
+                std::scoped_lock lock {request.state->mutex};
+                --request.state->pending;
+
+                if (!written && !request.state->failed_path.has_value())
+                {
+                    request.state->failed_path = std::move(request.path);
+                }
+            }
+
+            request.state->condition.notify_all();
+        }
+    };
+}
\ No newline at end of file
@@ -2,12 +2,75 @@
 
 #include <atomic>
 #include <cstddef>
+#include <utility>
+#include <vector>
 
 namespace spore::codegen
 {
-    template <typename>
+    // Ids made on this thread while a scope is alive are counted from the start of the scope, e.g. the conversion of
+    // an input, rather than from the start of the run. The same input then always gets the same ids, whichever other
+    // inputs are converted along with it. Scopes of different indices, e.g. of the inputs of a stage, never make the
+    // same ids, the index is kept in the high bits and the count in the low bits.
+    struct unique_id_scope
+    {
+        static constexpr std::size_t count_bits = 32;
+
+        explicit unique_id_scope(const std::size_t index = 0)
+            : _offset(index << count_bits),
+              _previous_scope(std::exchange(_current_scope, this))
+        {
+        }
+
+        ~unique_id_scope()
+        {
+            _current_scope = _previous_scope;
+        }
+
+        unique_id_scope(const unique_id_scope&) = delete;
+        unique_id_scope(unique_id_scope&&) = delete;
+
+        unique_id_scope& operator=(const unique_id_scope&) = delete;
+        unique_id_scope& operator=(unique_id_scope&&) = delete;
+
+        static unique_id_scope* current()
+        {
+            return _current_scope;
+        }
+
+        // Ids are counted per type, like outside of a scope.
+        template <typename value_t>
+        std::size_t make_id()
+        {
+            static constexpr char tag = 0;
+
+            for (auto& [count_tag, count] : _counts)
+            {
+                if (count_tag == &tag)
+                {
+                    return _offset + ++count;
+                }
+            }
+
+            _counts.emplace_back(&tag, 1);
+            return _offset + 1;
+        }
+
+      private:
+        static inline thread_local unique_id_scope* _current_scope = nullptr;
+
+        std::vector<std::pair<const void*, std::size_t>> _counts;
+        std::size_t _offset;
+        unique_id_scope* _previous_scope;
+    };
+
+    template <typename value_t>
     std::size_t make_unique_id()
     {
+        if (unique_id_scope* scope = unique_id_scope::current())
+        {
+            return scope->make_id<value_t>();
+        }
+
         static std::atomic<std::size_t> seed;
         return ++seed;
     }
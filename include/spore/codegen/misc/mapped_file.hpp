@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace spore::codegen
+{
+    // Read-only view of the content of a file. Large files are mapped in memory, smaller ones, and every file on
+    // platforms without `mmap`, are read at once into a buffer of the size of the file.
+    struct mapped_file
+    {
+        mapped_file() = default;
+
+        ~mapped_file()
+        {
+            close();
+        }
+
+        mapped_file(const mapped_file&) = delete;
+
+        mapped_file(mapped_file&& other) noexcept
+            : _data(std::exchange(other._data, nullptr)),
+              _size(std::exchange(other._size, 0)),
+              _mapped(std::exchange(other._mapped, false)),
+              _buffer(std::move(other._buffer))
+        {
+        }
+
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        mapped_file& operator=(mapped_file&& other) noexcept
+        {
+            if (this != &other)
+            {
+                close();
+                _data = std::exchange(other._data, nullptr);
+                _size = std::exchange(other._size, 0);
+                _mapped = std::exchange(other._mapped, false);
+                _buffer = std::move(other._buffer);
+            }
+
+            return *this;
+        }
+
+        bool open(const std::filesystem::path& path)
+        {
+            close();
+
+#if !defined(_WIN32)
+            const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (descriptor < 0)
+            {
+                return false;
+            }
+
+            struct ::stat native_stat;
+            bool opened = ::fstat(descriptor, &native_stat) == 0 && S_ISREG(native_stat.st_mode);
+
+            if (opened)
+            {
+                _size = static_cast<std::size_t>(native_stat.st_size);
+
+                if (_size >= map_threshold)
+                {
+                    void* data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+                    if (data != MAP_FAILED)
+                    {
+                        _data = static_cast<const std::uint8_t*>(data);
+                        _mapped = true;
+                    }
+                }
+
+                if (!_mapped)
+                {
+                    opened = read_descriptor(descriptor);
+                }
+            }
+
+            ::close(descriptor);
+
+            if (!opened)
+            {
+                close();
+            }
+
+            return opened;
+#else
+            std::ifstream stream(path, std::ios::in | std::ios::binary);
+            if (!stream.is_open())
+            {
+                return false;
+            }
+
+            std::error_code error;
+            _size = static_cast<std::size_t>(std::filesystem::file_size(path, error));
+
+            if (error)
+            {
+                close();
+                return false;
+            }
+
+            _buffer.resize(_size);
+            stream.read(reinterpret_cast<char*>(_buffer.data()), static_cast<std::streamsize>(_size));
+
+            if (stream.bad() || static_cast<std::size_t>(stream.gcount()) != _size)
+            {
+                close();
+                return false;
+            }
+
+            _data = _buffer.data();
+            return true;
+#endif
+        }
+
+        void close()
+        {
+#if !defined(_WIN32)
+            if (_mapped)
+            {
+                ::munmap(const_cast<std::uint8_t*>(_data), _size);
+            }
+#endif
+
+            _data = nullptr;
+            _size = 0;
+            _mapped = false;
+            _buffer.clear();
+        }
+
+        [[nodiscard]] std::span<const std::uint8_t> bytes() const
+        {
+            return {_data, _size};
+        }
+
+        [[nodiscard]] std::string_view text() const
+        {
+            return {reinterpret_cast<const char*>(_data), _size};
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return _size;
+        }
+
+      private:
+        // Mapping has a fixed cost that a single read of a small file does not.
+        static constexpr std::size_t map_threshold = 64 * 1024;
+
+        const std::uint8_t* _data = nullptr;
+        std::size_t _size = 0;
+        bool _mapped = false;
+        std::vector<std::uint8_t> _buffer;
+
+#if !defined(_WIN32)
+        bool read_descriptor(const int descriptor)
+        {
+            _buffer.resize(_size);
+            std::size_t offset = 0;
+
+            while (offset < _size)
+            {
+                const ::ssize_t count = ::read(descriptor, _buffer.data() + offset, _size - offset);
+
+                if (count < 0)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+
+                    return false;
+                }
+
+                if (count == 0)
+                {
+                    break;
+                }
+
+                offset += static_cast<std::size_t>(count);
+            }
+
+            // The file may have been truncated after it was checked.
+            _size = offset;
+            _data = _buffer.data();
+            return true;
+        }
+#endif
+    };
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "spore/codegen/codegen_error.hpp"
+#include "spore/codegen/misc/thread_pool.hpp"
+
+namespace spore::codegen
+{
+    struct task_graph
+    {
+        using task_t = std::function<void()>;
+
+        std::size_t add_task(task_t task)
+        {
+            const std::size_t task_index = _nodes.size();
+            _nodes.emplace_back().task = std::move(task);
+            return task_index;
+        }
+
+        void add_dependency(const std::size_t task_index, const std::size_t dependency_index)
+        {
+            _nodes.at(dependency_index).dependents.emplace_back(task_index);
+            ++_nodes.at(task_index).dependency_count;
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return _nodes.size();
+        }
+
+        // Runs every task once all of its dependencies are completed, independent tasks are spread over the
+        // pool and the calling thread. If a task fails, no new task is started and the first exception is
+        // rethrown once running tasks are completed.
+        void run(thread_pool& pool)
+        {
+            check_cycles();
+
+            const auto state = std::make_shared<graph_state>();
+            state->nodes = _nodes;
+
+            for (std::size_t task_index = 0; task_index < state->nodes.size(); ++task_index)
+            {
+                if (state->nodes.at(task_index).dependency_count == 0)
+                {
+                    state->ready.emplace_back(task_index);
+                }
+            }
+
+            const bool use_pool = pool.size() > 1;
+
+            if (use_pool)
+            {
+                // Submitted tasks start consuming the ready queue right away, its initial size is read beforehand.
+                const std::size_t ready_count = state->ready.size();
+
+                for (std::size_t index = 1; index < ready_count; ++index)
+                {
+                    pool.submit([state, &pool] { run_ready(state, pool, false); });
+                }
+            }
+
+            std::unique_lock lock {state->mutex};
+
+            while (true)
+            {
+                if (state->exception == nullptr && !state->ready.empty())
+                {
+                    lock.unlock();
+                    run_ready(state, pool, use_pool);
+                    lock.lock();
+                }
+                else if (state->running == 0)
+                {
+                    break;
+                }
+                else
+                {
+                    const auto predicate = [&] { return (state->exception == nullptr && !state->ready.empty()) || state->running == 0; };
+                    state->condition.wait(lock, predicate);
+                }
+            }
+
+            if (state->exception != nullptr)
+            {
+                std::rethrow_exception(state->exception);
+            }
+        }
+
+      private:
+        struct task_node
+        {
+            task_t task;
+            std::vector<std::size_t> dependents;
+            std::size_t dependency_count = 0;
+        };
+
+        struct graph_state
+        {
+            std::vector<task_node> nodes;
+            std::deque<std::size_t> ready;
+            std::size_t running = 0;
+            std::exception_ptr exception;
+            std::mutex mutex;
+            std::condition_variable condition;
+        };
+
+        std::vector<task_node> _nodes;
+
+        static void run_ready(const std::shared_ptr<graph_state>& state, thread_pool& pool, const bool use_pool)
+        {
+            std::size_t task_index;
+
+            {
+                std::scoped_lock lock {state->mutex};
+
+                if (state->exception != nullptr || state->ready.empty())
+                {
+                    return;
+                }
+
+                task_index = state->ready.front();
+                state->ready.pop_front();
+                ++state->running;
+            }
+
+            std::exception_ptr exception;
+
+            try
+            {
+                state->nodes.at(task_index).task();
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+
+            std::size_t ready_count = 0;
+
+            {
+                std::scoped_lock lock {state->mutex};
+                --state->running;
+
+                if (exception != nullptr)
+                {
+                    if (state->exception == nullptr)
+                    {
+                        state->exception = std::move(exception);
+                    }
+                }
+                else
+                {
+                    for (const std::size_t dependent_index : state->nodes.at(task_index).dependents)
+                    {
+                        if (--state->nodes.at(dependent_index).dependency_count == 0)
+                        {
+                            state->ready.emplace_back(dependent_index);
+                            ++ready_count;
+                        }
+                    }
+                }
+            }
+
+            state->condition.notify_all();
+
+            if (use_pool)
+            {
+                for (std::size_t index = 0; index < ready_count; ++index)
+                {
+                    pool.submit([state, &pool] { run_ready(state, pool, true); });
+                }
+            }
+        }
+
+        void check_cycles() const
+        {
+            std::vector<std::size_t> dependency_counts;
+            dependency_counts.reserve(_nodes.size());
+
+            std::vector<std::size_t> ready;
+
+            for (std::size_t task_index = 0; task_index < _nodes.size(); ++task_index)
+            {
+                dependency_counts.emplace_back(_nodes.at(task_index).dependency_count);
+
+                if (dependency_counts.back() == 0)
+                {
+                    ready.emplace_back(task_index);
+                }
+            }
+
+            std::size_t visited = 0;
+
+            while (!ready.empty())
+            {
+                const std::size_t task_index = ready.back();
+                ready.pop_back();
+                ++visited;
+
+                for (const std::size_t dependent_index : _nodes.at(task_index).dependents)
+                {
+                    if (--dependency_counts.at(dependent_index) == 0)
+                    {
+                        ready.emplace_back(dependent_index);
+                    }
+                }
+            }
+
+            if (visited != _nodes.size())
+            {
+                throw codegen_error(codegen_error_code::invalid, "cyclic dependencies between tasks");
+            }
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "spore/codegen/misc/thread_pool.hpp"
+
+namespace spore::codegen
+{
+    // Group of tasks submitted to a pool one at a time, for producers that do not know the number of tasks up
+    // front. Tasks run inline when the pool has no workers. If a task fails, tasks that are not started yet are
+    // skipped and the first exception is rethrown by `wait`.
+    struct task_group
+    {
+        using task_t = std::function<void()>;
+
+        explicit task_group(thread_pool& pool)
+            : _pool(pool),
+              _state(std::make_shared<group_state>())
+        {
+        }
+
+        ~task_group()
+        {
+            // Tasks may reference the scope of the group, they must be completed before it is unwound.
+            try
+            {
+                wait();
+            }
+            catch (...)
+            {
+            }
+        }
+
+        task_group(const task_group&) = delete;
+        task_group(task_group&&) = delete;
+
+        task_group& operator=(const task_group&) = delete;
+        task_group& operator=(task_group&&) = delete;
+
+        void run(task_t task)
+        {
+            {
+                std::scoped_lock lock {_state->mutex};
+                ++_state->pending;
+            }
+
+            if (_pool.size() > 1)
+            {
+                _pool.submit([state = _state, task = std::move(task)] { run_task(*state, task); });
+            }
+            else
+            {
+                run_task(*_state, task);
+            }
+        }
+
+        void wait()
+        {
+            while (true)
+            {
+                {
+                    std::scoped_lock lock {_state->mutex};
+
+                    if (_state->pending == 0)
+                    {
+                        break;
+                    }
+                }
+
+                // Tasks of this group are only submitted by the waiting thread, if the queue is empty, the remaining
+                // ones are already running on other threads.
+                if (!_pool.run_pending_task())
+                {
+                    std::unique_lock lock {_state->mutex};
+                    _state->condition.wait(lock, [&] { return _state->pending == 0; });
+                }
+            }
+
+            std::exception_ptr exception;
+
+            {
+                std::scoped_lock lock {_state->mutex};
+                exception = std::exchange(_state->exception, nullptr);
+            }
+
+            if (exception != nullptr)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+
+      private:
+        struct group_state
+        {
+            std::size_t pending = 0;
+            std::exception_ptr exception;
+            std::mutex mutex;
+            std::condition_variable condition;
+        };
+
+        thread_pool& _pool;
+        std::shared_ptr<group_state> _state;
+
+        static void run_task(group_state& state, const task_t& task)
+        {
+            bool failed;
+
+            {
+                std::scoped_lock lock {state.mutex};
+                failed = state.exception != nullptr;
+            }
+
+            std::exception_ptr exception;
+
+            if (!failed)
+            {
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
+            }
+
+            {
+                std::scoped_lock lock {state.mutex};
+                --state.pending;
+
+                if (exception != nullptr && state.exception == nullptr)
+                {
+                    state.exception = std::move(exception);
+                }
+            }
+
+            state.condition.notify_all();
+        }
+    };
+}
\ No newline at end of file
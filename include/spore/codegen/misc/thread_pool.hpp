@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace spore::codegen
+{
+    struct thread_pool
+    {
+        using task_t = std::function<void()>;
+
+        explicit thread_pool(std::size_t thread_count = 1)
+        {
+            if (thread_count == 0)
+            {
+                thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+
+            // The calling thread always participates in the work, it is slot 0.
+            const std::size_t worker_count = thread_count - 1;
+            _workers.reserve(worker_count);
+
+            for (std::size_t index = 0; index < worker_count; ++index)
+            {
+                _workers.emplace_back([this, slot = index + 1] { run_worker(slot); });
+            }
+        }
+
+        ~thread_pool()
+        {
+            {
+                std::scoped_lock lock {_mutex};
+                _stopping = true;
+            }
+
+            _condition.notify_all();
+
+            for (std::thread& worker : _workers)
+            {
+                worker.join();
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool(thread_pool&&) = delete;
+
+        thread_pool& operator=(const thread_pool&) = delete;
+        thread_pool& operator=(thread_pool&&) = delete;
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return _workers.size() + 1;
+        }
+
+        [[nodiscard]] static std::size_t current_slot()
+        {
+            return _slot;
+        }
+
+        void submit(task_t task)
+        {
+            {
+                std::scoped_lock lock {_mutex};
+                _tasks.emplace_back(std::move(task));
+            }
+
+            _condition.notify_one();
+        }
+
+        // Runs a single queued task on the calling thread, if any. Threads waiting on tasks of the pool use it to
+        // help instead of blocking, which keeps nested waits from exhausting the workers.
+        bool run_pending_task()
+        {
+            task_t task;
+
+            {
+                std::scoped_lock lock {_mutex};
+
+                if (_tasks.empty())
+                {
+                    return false;
+                }
+
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+
+            task();
+            return true;
+        }
+
+        template <typename func_t>
+        void parallel_for(const std::size_t count, func_t&& func)
+        {
+            if (_workers.empty() || count <= 1)
+            {
+                for (std::size_t index = 0; index < count; ++index)
+                {
+                    func(index);
+                }
+
+                return;
+            }
+
+            struct parallel_state
+            {
+                std::atomic<std::size_t> next = 0;
+                std::size_t completed = 0;
+                std::exception_ptr exception;
+                std::mutex mutex;
+                std::condition_variable condition;
+            };
+
+            // Runners may still be queued after this call returns, the state is shared so that they can bail
+            // out safely; they only touch the function once they have claimed a valid index. Every index is
+            // run even if one of them fails, the first exception is rethrown once all of them are completed.
+            const auto state = std::make_shared<parallel_state>();
+
+            const auto runner = [state, count, func_ptr = std::addressof(func)] {
+                std::size_t index;
+                while ((index = state->next.fetch_add(1)) < count)
+                {
+                    std::exception_ptr exception;
+
+                    try
+                    {
+                        (*func_ptr)(index);
+                    }
+                    catch (...)
+                    {
+                        exception = std::current_exception();
+                    }
+
+                    std::scoped_lock lock {state->mutex};
+
+                    if (exception != nullptr && state->exception == nullptr)
+                    {
+                        state->exception = std::move(exception);
+                    }
+
+                    if (++state->completed == count)
+                    {
+                        state->condition.notify_all();
+                    }
+                }
+            };
+
+            const std::size_t runner_count = std::min(count - 1, _workers.size());
+
+            for (std::size_t index = 0; index < runner_count; ++index)
+            {
+                submit(runner);
+            }
+
+            runner();
+
+            std::unique_lock lock {state->mutex};
+            state->condition.wait(lock, [&] { return state->completed == count; });
+
+            if (state->exception != nullptr)
+            {
+                std::rethrow_exception(state->exception);
+            }
+        }
+
+      private:
+        static inline thread_local std::size_t _slot = 0;
+
+        std::vector<std::thread> _workers;
+        std::deque<task_t> _tasks;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _stopping = false;
+
+        void run_worker(const std::size_t slot)
+        {
+            _slot = slot;
+
+            while (true)
+            {
+                task_t task;
+
+                {
+                    std::unique_lock lock {_mutex};
+                    _condition.wait(lock, [&] { return _stopping || !_tasks.empty(); });
+
+                    if (_tasks.empty())
+                    {
+                        return;
+                    }
+
+                    task = std::move(_tasks.front());
+                    _tasks.pop_front();
+                }
+
+                task();
+            }
+        }
+    };
+}
\ No newline at end of file
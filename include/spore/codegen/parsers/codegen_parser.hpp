@@ -1,14 +1,57 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
 #include <vector>
 
+#include "spore/codegen/misc/thread_pool.hpp"
+
 namespace spore::codegen
 {
     template <typename ast_t>
     struct codegen_parser
     {
+        using ast_callback_t = std::function<void(ast_t&& ast)>;
+        using dependencies_callback_t = std::function<void(std::size_t path_index, std::vector<std::string>&& dependencies)>;
+
         virtual ~codegen_parser() = default;
-        [[nodiscard]] virtual bool parse_asts(const std::vector<std::string>& paths, std::vector<ast_t>& asts) = 0;
+
+        // Hands every ast to the callback as soon as it is parsed, in the order of the given paths. Parsers that read
+        // other files while parsing a path, e.g. included headers, report their absolute paths to the dependencies
+        // callback, if any, so that the path can be parsed again when one of them changes.
+        [[nodiscard]] virtual bool parse_asts(const std::vector<std::string>& paths, const ast_callback_t& callback, const dependencies_callback_t& dependencies_callback) = 0;
+
+        // Everything other than the input files that asts depend on, e.g. compiler arguments. Results parsed with
+        // another fingerprint are never reused.
+        [[nodiscard]] virtual std::string fingerprint() const
+        {
+            return {};
+        }
+
+        // Pool of the run, parsers that parse paths concurrently run their work on it rather than on threads of their
+        // own, so that the whole run stays within its number of jobs.
+        virtual void share_pool(thread_pool&)
+        {
+        }
+
+        // Ast of a path known to declare nothing, e.g. one without any marker of its stage, made without reading it.
+        [[nodiscard]] virtual ast_t make_empty_ast(const std::string& path) const
+        {
+            ast_t ast;
+            ast.path = path;
+            return ast;
+        }
+
+        [[nodiscard]] bool parse_asts(const std::vector<std::string>& paths, const ast_callback_t& callback)
+        {
+            return parse_asts(paths, callback, nullptr);
+        }
+
+        [[nodiscard]] bool parse_asts(const std::vector<std::string>& paths, std::vector<ast_t>& asts)
+        {
+            asts.reserve(asts.size() + paths.size());
+            return parse_asts(paths, [&](ast_t&& ast) { asts.emplace_back(std::move(ast)); });
+        }
     };
 }
\ No newline at end of file
@@ -226,6 +226,7 @@ namespace spore::codegen
 
     inline void to_json(nlohmann::json& json, const cpp_file& value)
     {
+        // Ids are made in the scope of the caller, e.g. one per input of a stage, or counted from the start of the run.
         json["id"] = make_unique_id<cpp_file>();
         json["path"] = value.path;
         json["classes"] = value.classes;
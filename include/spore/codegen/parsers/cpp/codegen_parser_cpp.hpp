@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "spore/codegen/parsers/codegen_parser.hpp"
@@ -8,16 +13,60 @@
 
 namespace spore::codegen
 {
+    namespace detail
+    {
+        struct cpp_preamble;
+        struct cpp_preambles;
+
+        std::shared_ptr<cpp_preambles> make_cpp_preambles();
+    }
+
     struct codegen_parser_cpp final : codegen_parser<cpp_file>
     {
         std::vector<std::string> additional_args;
 
+        // Maximum number of translation units parsed concurrently when no pool is shared, 0 to use all available cores.
+        // Inputs are only split when there are enough of them to make up for the headers every unit parses again.
+        std::size_t jobs;
+
+        // Headers included by most inputs, e.g. of the standard library or of third-party libraries, precompiled once
+        // and reused by later runs while the compiler arguments and every header they include are unchanged.
+        std::vector<std::string> preamble;
+
+        // Prefix of the files the precompiled preamble is stored in, e.g. the path of the cache.
+        std::string preamble_path;
+
         template <typename args_t>
-        explicit codegen_parser_cpp(const args_t& additional_args)
-            : additional_args(std::begin(additional_args), std::end(additional_args))
+        explicit codegen_parser_cpp(const args_t& additional_args, const std::size_t jobs = 1, std::vector<std::string> preamble = {}, std::string preamble_path = {})
+            : additional_args(std::begin(additional_args), std::end(additional_args)),
+              jobs(jobs != 0 ? jobs : std::max(std::thread::hardware_concurrency(), 1u)),
+              preamble(std::move(preamble)),
+              preamble_path(std::move(preamble_path)),
+              _preambles(detail::make_cpp_preambles())
         {
         }
 
-        bool parse_asts(const std::vector<std::string>& paths, std::vector<cpp_file>& cpp_files) override;
+        using codegen_parser::parse_asts;
+
+        bool parse_asts(const std::vector<std::string>& paths, const ast_callback_t& callback, const dependencies_callback_t& dependencies_callback) override;
+
+        std::string fingerprint() const override;
+
+        void share_pool(thread_pool& pool) override;
+
+        cpp_file make_empty_ast(const std::string& path) const override;
+
+      private:
+        thread_pool* _pool = nullptr;
+
+        // Preambles are checked once per run and per directory, since include directories may be relative to it, and
+        // only precompiled once inputs of the directory are parsed.
+        std::shared_ptr<detail::cpp_preambles> _preambles;
+
+        [[nodiscard]] detail::cpp_preamble* get_preamble(const std::vector<std::string>& args) const;
+
+        [[nodiscard]] std::string get_preamble_digest(const std::vector<std::string>& args) const;
+
+        [[nodiscard]] std::vector<std::string> make_args() const;
     };
 }
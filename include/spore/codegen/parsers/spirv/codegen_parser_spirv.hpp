@@ -18,6 +18,8 @@ namespace spore::codegen
             }
         }
 
-        bool parse_asts(const std::vector<std::string>& paths, std::vector<spirv_module>& modules) override;
+        using codegen_parser::parse_asts;
+
+        bool parse_asts(const std::vector<std::string>& paths, const ast_callback_t& callback, const dependencies_callback_t& dependencies_callback) override;
     };
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "nlohmann/json.hpp"
 
@@ -11,5 +13,7 @@ namespace spore::codegen
         virtual ~codegen_renderer() = default;
         [[nodiscard]] virtual bool render_file(const std::string& file, const nlohmann::json& data, std::string& result) = 0;
         [[nodiscard]] virtual bool can_render_file(const std::string& file) const = 0;
+        [[nodiscard]] virtual bool find_includes(const std::string& file, std::vector<std::string>& includes) const = 0;
+        [[nodiscard]] virtual std::unique_ptr<codegen_renderer> clone() const = 0;
     };
 }
\ No newline at end of file
@@ -19,6 +19,18 @@ namespace spore::codegen
             (renderers.emplace_back(std::move(renderers_)), ...);
         }
 
+        codegen_renderer_composite(const codegen_renderer_composite& other)
+        {
+            renderers.reserve(other.renderers.size());
+
+            for (const std::unique_ptr<codegen_renderer>& renderer : other.renderers)
+            {
+                renderers.emplace_back(renderer->clone());
+            }
+        }
+
+        codegen_renderer_composite(codegen_renderer_composite&&) noexcept = default;
+
         [[nodiscard]] bool render_file(const std::string& file, const nlohmann::json& data, std::string& result) override
         {
             const auto predicate = [&](const std::unique_ptr<codegen_renderer>& renderer) {
@@ -44,5 +56,27 @@ namespace spore::codegen
 
             return std::ranges::any_of(renderers, predicate);
         }
+
+        [[nodiscard]] bool find_includes(const std::string& file, std::vector<std::string>& includes) const override
+        {
+            const auto predicate = [&](const std::unique_ptr<codegen_renderer>& renderer) {
+                return renderer->can_render_file(file);
+            };
+
+            const auto it_renderer = std::ranges::find_if(renderers, predicate);
+
+            if (it_renderer != renderers.end())
+            {
+                const std::unique_ptr<codegen_renderer>& renderer = *it_renderer;
+                return renderer->find_includes(file, includes);
+            }
+
+            return false;
+        }
+
+        [[nodiscard]] std::unique_ptr<codegen_renderer> clone() const override
+        {
+            return std::make_unique<codegen_renderer_composite>(*this);
+        }
     };
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <filesystem>
 #include <format>
+#include <optional>
+#include <regex>
 #include <string>
 #include <vector>
 
@@ -14,7 +16,10 @@
 #include "nlohmann/json.hpp"
 #include "spdlog/spdlog.h"
 
+#include "spore/codegen/misc/current_path_scope.hpp"
+#include "spore/codegen/misc/defer.hpp"
 #include "spore/codegen/renderers/codegen_renderer.hpp"
+#include "spore/codegen/utils/files.hpp"
 #include "spore/codegen/utils/json.hpp"
 #include "spore/codegen/utils/strings.hpp"
 
@@ -402,7 +407,7 @@ namespace spore::codegen
             inja_env.add_callback("fs.absolute", 1,
                 [](const inja::Arguments& args) {
                     const std::string& value = args.at(0)->get<std::string>();
-                    return std::filesystem::absolute(std::filesystem::path(value)).string();
+                    return current_path_scope::absolute(std::filesystem::path(value)).string();
                 });
 
             inja_env.add_callback("fs.extension", 1,
@@ -479,6 +484,49 @@ namespace spore::codegen
             return ".inja" == std::filesystem::path(file).extension();
         }
 
+        [[nodiscard]] bool find_includes(const std::string& file, std::vector<std::string>& includes) const override
+        {
+            std::string content;
+
+            if (!files::read_file(file, content))
+            {
+                return false;
+            }
+
+            // The include callback searches template directories, while the include statement is relative to the
+            // including template.
+            static const std::regex include_callback_regex {R"regex(include\s*\(\s*"([^"]+)")regex"};
+            static const std::regex include_statement_regex {R"regex(\{%-?\s*include\s+"([^"]+)")regex"};
+
+            for (auto it = std::sregex_iterator(content.begin(), content.end(), include_callback_regex); it != std::sregex_iterator(); ++it)
+            {
+                if (const std::optional<std::filesystem::path> include_file = find_include_file((*it)[1].str()))
+                {
+                    includes.emplace_back(include_file->string());
+                }
+            }
+
+            const std::filesystem::path directory = current_path_scope::absolute(file).parent_path();
+
+            for (auto it = std::sregex_iterator(content.begin(), content.end(), include_statement_regex); it != std::sregex_iterator(); ++it)
+            {
+                const std::filesystem::path include_file = directory / (*it)[1].str();
+
+                if (std::filesystem::exists(include_file))
+                {
+                    includes.emplace_back(include_file.lexically_normal().string());
+                }
+            }
+
+            return true;
+        }
+
+        [[nodiscard]] std::unique_ptr<codegen_renderer> clone() const override
+        {
+            // The environment holds callbacks bound to this instance and a template cache, it cannot be shared.
+            return std::make_unique<codegen_renderer_inja>(templates);
+        }
+
       private:
         static inline thread_local const nlohmann::json* _json_this = nullptr;
 
@@ -515,18 +563,28 @@ namespace spore::codegen
                 json = nlohmann::json::value_t::null;
             }
 
+            if (const std::optional<std::filesystem::path> template_abs = find_include_file(file))
+            {
+                const auto action = [&] { return inja_env.render_file(template_abs->string(), json); };
+                return with_this(json, action);
+            }
+
+            throw codegen_error(codegen_error_code::rendering, "cannot find include template, file={}", file);
+        }
+
+        [[nodiscard]] std::optional<std::filesystem::path> find_include_file(const std::string& file) const
+        {
             for (const std::string& template_ : templates)
             {
                 std::filesystem::path template_abs = std::filesystem::path(template_) / file;
 
                 if (std::filesystem::exists(template_abs))
                 {
-                    const auto action = [&] { return inja_env.render_file(template_abs.string(), json); };
-                    return with_this(json, action);
+                    return template_abs;
                 }
             }
 
-            throw codegen_error(codegen_error_code::rendering, "cannot find include template, file={}", file);
+            return std::nullopt;
         }
     };
 }
\ No newline at end of file
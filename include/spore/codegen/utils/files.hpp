@@ -1,18 +1,34 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <format>
 #include <fstream>
+#include <random>
 #include <sstream>
 #include <string>
 #include <string_view>
 #include <vector>
 
-#include "picosha2.h"
+#include <sys/stat.h>
 
+#include "spore/codegen/misc/current_path_scope.hpp"
+#include "spore/codegen/misc/mapped_file.hpp"
+#include "spore/codegen/utils/hashes.hpp"
 #include "spore/codegen/utils/yaml.hpp"
 
 namespace spore::codegen::files
 {
+    struct file_stat
+    {
+        std::size_t size = 0;
+        std::int64_t mtime = 0;
+        std::int64_t ctime = 0;
+        std::uint64_t inode = 0;
+
+        bool operator==(const file_stat&) const = default;
+    };
+
     namespace detail
     {
         enum class json_file_type
@@ -52,10 +68,61 @@ namespace spore::codegen::files
 
         inline bool create_directories(const std::string_view path)
         {
-            const std::filesystem::path parent = std::filesystem::path(path).parent_path();
+            const std::filesystem::path parent = current_path_scope::absolute(path).parent_path();
+
+            std::error_code error;
+            std::filesystem::create_directories(parent, error);
+            return !error;
+        }
+
+        inline std::filesystem::path make_temp_path(const std::filesystem::path& path)
+        {
+            thread_local std::mt19937_64 engine {std::random_device {}()};
+
+            std::filesystem::path temp_path = path;
+            temp_path += std::format(".{:016x}.tmp", engine());
+            return temp_path;
+        }
+
+        // Writes to a temporary file next to the target, then renames it over the target, so that readers never see
+        // a partially written file.
+        template <typename func_t>
+        bool write_file_atomic(const std::string_view path, const std::ios::openmode mode, func_t&& func)
+        {
+            const std::filesystem::path file_path = current_path_scope::absolute(path);
+            const std::filesystem::path temp_path = make_temp_path(file_path);
+
+            std::error_code error;
 
-            if (!parent.empty() && !std::filesystem::exists(parent) && !std::filesystem::create_directories(parent))
             {
+                std::ofstream stream(temp_path, mode);
+
+                // Directories are only created when the file cannot be opened, instead of being checked on every write.
+                if (!stream.is_open())
+                {
+                    if (!create_directories(path))
+                    {
+                        return false;
+                    }
+
+                    stream.open(temp_path, mode);
+                }
+
+                func(stream);
+                stream.close();
+
+                if (stream.fail())
+                {
+                    std::filesystem::remove(temp_path, error);
+                    return false;
+                }
+            }
+
+            std::filesystem::rename(temp_path, file_path, error);
+
+            if (error)
+            {
+                std::filesystem::remove(temp_path, error);
                 return false;
             }
 
@@ -65,28 +132,14 @@ namespace spore::codegen::files
 
     inline bool write_file(const std::string_view path, const std::string& content)
     {
-        if (!detail::create_directories(path))
-        {
-            return false;
-        }
-
-        std::ofstream stream(path.data());
-        stream << content;
-        stream.close();
-        return !stream.bad();
+        const auto write = [&](std::ofstream& stream) { stream << content; };
+        return detail::write_file_atomic(path, std::ios::out, write);
     }
 
     inline bool write_file(const std::string_view path, const std::vector<std::uint8_t>& bytes)
     {
-        if (!detail::create_directories(path))
-        {
-            return false;
-        }
-
-        std::ofstream stream(path.data(), std::ios::out | std::ios::binary);
-        stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
-        stream.close();
-        return !stream.bad();
+        const auto write = [&](std::ofstream& stream) { stream.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())); };
+        return detail::write_file_atomic(path, std::ios::out | std::ios::binary, write);
     }
 
     inline bool write_file(const std::string_view path, const nlohmann::json& json)
@@ -114,67 +167,65 @@ namespace spore::codegen::files
 
     inline bool read_file(const std::string_view path, std::string& content)
     {
-        const std::ifstream stream(path.data());
+        std::ifstream stream(current_path_scope::absolute(path));
         if (!stream.is_open())
         {
             return false;
         }
 
-        std::stringstream string;
-        string << stream.rdbuf();
-        content = string.str();
+        // The size is only an upper bound in text mode, line endings may be translated.
+        std::error_code error;
+        const std::uintmax_t size = std::filesystem::file_size(current_path_scope::absolute(path), error);
+
+        content.resize(error ? 0 : static_cast<std::size_t>(size));
+        stream.read(content.data(), static_cast<std::streamsize>(content.size()));
+        content.resize(static_cast<std::size_t>(stream.gcount()));
+
         return !stream.bad();
     }
 
     inline bool read_file(const std::string_view path, std::vector<std::uint8_t>& bytes)
     {
-        std::ifstream stream(path.data(), std::ios::in | std::ios::binary);
-        if (!stream.is_open())
+        mapped_file file;
+        if (!file.open(current_path_scope::absolute(path)))
         {
             return false;
         }
 
-        bytes = {
-            std::istreambuf_iterator<char>(stream),
-            std::istreambuf_iterator<char>(),
-        };
-
-        stream.close();
-        return !stream.bad();
+        bytes.assign(file.bytes().begin(), file.bytes().end());
+        return true;
     }
 
     inline bool read_file(const std::string_view path, nlohmann::json& json)
     {
         json = nlohmann::json(nlohmann::json::value_t::discarded);
-        switch (detail::get_json_type(path))
+
+        const detail::json_file_type json_type = detail::get_json_type(path);
+        if (json_type == detail::json_file_type::none)
         {
-            case detail::json_file_type::json: {
-                std::string value;
-                if (read_file(path, value))
-                {
-                    json = nlohmann::json::parse(value, nullptr, false, false);
-                }
+            return false;
+        }
 
+        mapped_file file;
+        if (!file.open(current_path_scope::absolute(path)))
+        {
+            return false;
+        }
+
+        switch (json_type)
+        {
+            case detail::json_file_type::json: {
+                json = nlohmann::json::parse(file.text(), nullptr, false, false);
                 break;
             }
 
             case detail::json_file_type::bson: {
-                std::vector<std::uint8_t> value;
-                if (read_file(path, value))
-                {
-                    json = nlohmann::json::from_bson(value, true, false);
-                }
-
+                json = nlohmann::json::from_bson(file.bytes().begin(), file.bytes().end(), true, false);
                 break;
             }
 
             case detail::json_file_type::yaml: {
-                std::string value;
-                if (read_file(path, value))
-                {
-                    json = yaml::from_yaml(value);
-                }
-
+                json = yaml::from_yaml(file.text());
                 break;
             }
 
@@ -186,15 +237,75 @@ namespace spore::codegen::files
         return !json.is_discarded();
     }
 
-    inline bool hash_file(const std::string_view path, std::string& hash)
+    // Writes the content only if it differs from the file on disk, so that unchanged files keep their modification
+    // time and do not trigger a rebuild of everything that depends on them. The content is written as is, without
+    // newline conversions, so that it is compared with the same bytes on the next write.
+    inline bool write_file_if_changed(const std::string_view path, const std::string& content, bool& changed)
+    {
+        mapped_file existing_file;
+        changed = !existing_file.open(current_path_scope::absolute(path)) || existing_file.text() != content;
+        existing_file.close();
+
+        if (!changed)
+        {
+            return true;
+        }
+
+        const auto write = [&](std::ofstream& stream) { stream.write(content.data(), static_cast<std::streamsize>(content.size())); };
+        return detail::write_file_atomic(path, std::ios::out | std::ios::binary, write);
+    }
+
+    // Times are in nanoseconds since epoch where the platform provides them, in seconds otherwise. On Windows, the
+    // change time is the creation time and there is no inode.
+    inline bool stat_file(const std::string_view path, file_stat& stat)
+    {
+        const std::string file_path = current_path_scope::absolute(path).string();
+
+#if defined(_WIN32)
+        struct _stat64 native_stat;
+
+        if (_stat64(file_path.c_str(), &native_stat) != 0)
+        {
+            return false;
+        }
+
+        stat.mtime = static_cast<std::int64_t>(native_stat.st_mtime) * 1'000'000'000;
+        stat.ctime = static_cast<std::int64_t>(native_stat.st_ctime) * 1'000'000'000;
+        stat.inode = 0;
+#else
+        struct ::stat native_stat;
+
+        if (::stat(file_path.c_str(), &native_stat) != 0)
+        {
+            return false;
+        }
+
+#    if defined(__APPLE__)
+        const timespec& mtime = native_stat.st_mtimespec;
+        const timespec& ctime = native_stat.st_ctimespec;
+#    else
+        const timespec& mtime = native_stat.st_mtim;
+        const timespec& ctime = native_stat.st_ctim;
+#    endif
+
+        stat.mtime = static_cast<std::int64_t>(mtime.tv_sec) * 1'000'000'000 + mtime.tv_nsec;
+        stat.ctime = static_cast<std::int64_t>(ctime.tv_sec) * 1'000'000'000 + ctime.tv_nsec;
+        stat.inode = static_cast<std::uint64_t>(native_stat.st_ino);
+#endif
+
+        stat.size = static_cast<std::size_t>(native_stat.st_size);
+        return true;
+    }
+
+    inline bool hash_file(const std::string_view path, const hashes::hash_algorithm algorithm, std::string& hash)
     {
-        std::vector<std::uint8_t> data;
-        if (!read_file(path, data))
+        mapped_file file;
+        if (!file.open(current_path_scope::absolute(path)))
         {
             return false;
         }
 
-        picosha2::hash256_hex_string(data.begin(), data.end(), hash);
+        hash = hashes::hash(algorithm, file.bytes());
         return true;
     }
 }
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "picosha2.h"
+
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+namespace spore::codegen::hashes
+{
+    enum class hash_algorithm
+    {
+        xxh3,
+        sha256,
+    };
+
+    namespace detail
+    {
+        struct hash_algorithm_name
+        {
+            hash_algorithm algorithm;
+            std::string_view name;
+        };
+
+        constexpr hash_algorithm_name hash_algorithm_names[] {
+            {hash_algorithm::xxh3, "xxh3"},
+            {hash_algorithm::sha256, "sha256"},
+        };
+    }
+
+    constexpr std::string_view to_string(const hash_algorithm algorithm)
+    {
+        for (const detail::hash_algorithm_name& name : detail::hash_algorithm_names)
+        {
+            if (name.algorithm == algorithm)
+            {
+                return name.name;
+            }
+        }
+
+        return {};
+    }
+
+    constexpr std::optional<hash_algorithm> from_string(const std::string_view value)
+    {
+        for (const detail::hash_algorithm_name& name : detail::hash_algorithm_names)
+        {
+            if (name.name == value)
+            {
+                return name.algorithm;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    // Hashes the data into a binary digest, 16 bytes for XXH3 and 32 bytes for SHA-256.
+    inline std::string hash(const hash_algorithm algorithm, const std::span<const std::uint8_t> data)
+    {
+        std::string digest;
+
+        switch (algorithm)
+        {
+            case hash_algorithm::xxh3: {
+                XXH128_canonical_t canonical;
+                XXH128_canonicalFromHash(&canonical, XXH3_128bits(data.data(), data.size()));
+                digest.assign(std::begin(canonical.digest), std::end(canonical.digest));
+                break;
+            }
+
+            case hash_algorithm::sha256: {
+                digest.resize(picosha2::k_digest_size);
+                picosha2::hash256(data.begin(), data.end(), digest.begin(), digest.end());
+                break;
+            }
+        }
+
+        return digest;
+    }
+
+    inline std::string hash(const hash_algorithm algorithm, const std::string_view data)
+    {
+        return hash(algorithm, std::span {reinterpret_cast<const std::uint8_t*>(data.data()), data.size()});
+    }
+
+    inline std::string to_hex(const std::string_view digest)
+    {
+        constexpr std::string_view digits = "0123456789abcdef";
+
+        std::string hex;
+        hex.reserve(digest.size() * 2);
+
+        for (const char c : digest)
+        {
+            const auto byte = static_cast<std::uint8_t>(c);
+            hex += digits[byte >> 4];
+            hex += digits[byte & 0xf];
+        }
+
+        return hex;
+    }
+
+    inline bool from_hex(const std::string_view hex, std::string& digest)
+    {
+        const auto to_nibble = [](const char c) -> int {
+            if (c >= '0' && c <= '9')
+            {
+                return c - '0';
+            }
+
+            if (c >= 'a' && c <= 'f')
+            {
+                return c - 'a' + 10;
+            }
+
+            if (c >= 'A' && c <= 'F')
+            {
+                return c - 'A' + 10;
+            }
+
+            return -1;
+        };
+
+        if (hex.size() % 2 != 0)
+        {
+            return false;
+        }
+
+        digest.clear();
+        digest.reserve(hex.size() / 2);
+
+        for (std::size_t index = 0; index < hex.size(); index += 2)
+        {
+            const int high = to_nibble(hex[index]);
+            const int low = to_nibble(hex[index + 1]);
+
+            if (high < 0 || low < 0)
+            {
+                return false;
+            }
+
+            digest += static_cast<char>((high << 4) | low);
+        }
+
+        return true;
+    }
+}
\ No newline at end of file
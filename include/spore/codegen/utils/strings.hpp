@@ -5,6 +5,7 @@
 #include <functional>
 #include <optional>
 #include <regex>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -90,6 +91,21 @@ namespace spore::codegen::strings
         }
     }
 
+    // Searches are done with the standard library, which looks for the first character of each value with memchr and
+    // only compares the rest where it is found.
+    inline bool contains_any(const std::string_view input, const std::span<const std::string> values)
+    {
+        for (const std::string& value : values)
+        {
+            if (input.find(value) != std::string_view::npos)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     template <typename container_t, typename projection_t = std::identity>
     std::string join(const std::string_view separator, const container_t& values, const projection_t& projection = {})
     {
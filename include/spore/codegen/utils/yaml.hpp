@@ -2,7 +2,10 @@
 
 #include <cmath>
 #include <cstdint>
+#include <istream>
+#include <streambuf>
 #include <string>
+#include <string_view>
 
 #include "nlohmann/json.hpp"
 #include "yaml-cpp/yaml.h"
@@ -11,8 +14,22 @@ namespace spore::codegen::yaml
 {
     namespace detail
     {
+        // Stream buffer reading directly from a view, so that the parser does not need its own copy of the input.
+        struct view_streambuf : std::streambuf
+        {
+            explicit view_streambuf(const std::string_view value)
+            {
+                char* data = const_cast<char*>(value.data());
+                setg(data, data, data + value.size());
+            }
+        };
+
         inline nlohmann::json parse_scalar(const YAML::Node& node)
         {
+            // Quoted scalars are always strings.
+            if (node.Tag() == "!")
+                return node.as<std::string>();
+
             bool b;
             if (YAML::convert<bool>::decode(node, b))
                 return b;
@@ -68,7 +85,18 @@ namespace spore::codegen::yaml
                 }
 
                 case nlohmann::detail::value_t::string: {
-                    yaml << YAML::Value << json.get<std::string>();
+                    // Strings that would be read back as another type, e.g. digests made only of digits, are quoted.
+                    const std::string& value = json.get<std::string>();
+                    const bool is_string = parse_scalar(YAML::Node(value)).is_string();
+
+                    yaml << YAML::Value;
+
+                    if (!is_string)
+                    {
+                        yaml << YAML::DoubleQuoted;
+                    }
+
+                    yaml << value;
                     break;
                 }
 
@@ -145,9 +173,12 @@ namespace spore::codegen::yaml
         return yaml.c_str();
     }
 
-    inline nlohmann::json from_yaml(const std::string& value)
+    inline nlohmann::json from_yaml(const std::string_view value)
     {
-        YAML::Node yaml = YAML::Load(value);
+        detail::view_streambuf streambuf {value};
+        std::istream stream {&streambuf};
+
+        YAML::Node yaml = YAML::Load(stream);
         return detail::from_yaml(yaml);
     }
 }
@@ -1,4 +1,7 @@
+#include <filesystem>
 #include <format>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -41,6 +44,8 @@ namespace spore::codegen
             constexpr auto file = "FILE";
             constexpr auto directory = "DIR";
             constexpr auto pair = "PAIR";
+            constexpr auto count = "N";
+            constexpr auto algorithm = "ALGORITHM";
         }
 
         std::pair<std::string, nlohmann::json> parse_pair(const std::string_view pair)
@@ -51,6 +56,18 @@ namespace spore::codegen
             return std::make_pair(std::string(name), nlohmann::json::parse(value));
         }
 
+        hashes::hash_algorithm parse_hash_algorithm(const std::string_view value)
+        {
+            const std::optional<hashes::hash_algorithm> algorithm = hashes::from_string(value);
+
+            if (!algorithm.has_value())
+            {
+                throw std::invalid_argument(std::format("invalid hash algorithm, algorithm={}", value));
+            }
+
+            return algorithm.value();
+        }
+
         template <typename ast_t>
         void register_default_conditions(codegen_condition_factory<ast_t>& factory)
         {
@@ -127,9 +144,15 @@ int main(const int argc, const char* argv[])
 
     arg_parser
         .add_argument("-C", "--cache")
-        .help("Codegen cache file to use")
+        .help("Codegen cache file to use, in a binary format unless its extension is .json, .bson or .yml")
         .metavar(detail::metavars::file)
-        .default_value(std::string {".codegen.yml"});
+        .default_value(std::string {".codegen.cache"});
+
+    arg_parser
+        .add_argument("--artifact-cache")
+        .help("Directory of a content addressed cache of parser results and outputs, that can be shared between working copies and machines")
+        .metavar(detail::metavars::directory)
+        .default_value(std::string {});
 
     arg_parser
         .add_argument("-t", "--templates")
@@ -146,6 +169,29 @@ int main(const int argc, const char* argv[])
         .append()
         .action(&detail::parse_pair);
 
+    arg_parser
+        .add_argument("-j", "--jobs")
+        .help("Number of threads to use for parsing and rendering, 0 to use all available cores")
+        .default_value(std::size_t {1})
+        .metavar(detail::metavars::count)
+        .scan<'u', std::size_t>();
+
+    arg_parser
+        .add_argument("-H", "--hash")
+        .help("Hash algorithm to use to detect changes in input files, one of \"xxh3\" or \"sha256\"")
+        .default_value(hashes::hash_algorithm::xxh3)
+        .metavar(detail::metavars::algorithm)
+        .action(&detail::parse_hash_algorithm);
+
+#ifdef SPORE_WITH_CPP
+    arg_parser
+        .add_argument("--cpp-preamble")
+        .help("Header included by most C++ inputs, e.g. of the standard library, to precompile next to the cache and reuse while it does not change")
+        .default_value(std::vector<std::string> {})
+        .metavar(detail::metavars::file)
+        .append();
+#endif
+
     arg_parser
         .add_argument("-r", "--reformat")
         .help("Whether to reformat output files or not")
@@ -179,8 +225,11 @@ int main(const int argc, const char* argv[])
     codegen_options options {
         .config = arg_parser.get<std::string>("--config"),
         .cache = arg_parser.get<std::string>("--cache"),
+        .artifact_cache = arg_parser.get<std::string>("--artifact-cache"),
         .templates = arg_parser.get<std::vector<std::string>>("--templates"),
         .user_data = arg_parser.get<std::vector<std::pair<std::string, nlohmann::json>>>("--user-data"),
+        .jobs = arg_parser.get<std::size_t>("--jobs"),
+        .hash = arg_parser.get<hashes::hash_algorithm>("--hash"),
         .reformat = arg_parser.get<bool>("--reformat"),
         .force = arg_parser.get<bool>("--force"),
         .debug = arg_parser.get<bool>("--debug"),
@@ -191,6 +240,12 @@ int main(const int argc, const char* argv[])
         spdlog::set_level(spdlog::level::debug);
     }
 
+    // The default cache file used to be `.codegen.yml`, it is not read anymore and is left to be removed.
+    if (!arg_parser.is_used("--cache") && std::filesystem::exists(".codegen.yml"))
+    {
+        SPDLOG_WARN("ignoring cache file of a previous version, it can be removed, file=.codegen.yml cache={}", options.cache);
+    }
+
     const auto parse_impl_args = [&]<typename impl_t> {
         const std::string prefix = std::format("--{}:", impl_t::name());
 
@@ -210,7 +265,12 @@ int main(const int argc, const char* argv[])
 #ifdef SPORE_WITH_CPP
     const auto cpp_args = parse_impl_args.operator()<codegen_impl<cpp_file>>();
     codegen_impl<cpp_file> impl_cpp {
-        codegen_parser_cpp {cpp_args},
+        codegen_parser_cpp {
+            cpp_args,
+            options.jobs,
+            arg_parser.get<std::vector<std::string>>("--cpp-preamble"),
+            std::filesystem::absolute(options.cache).string(),
+        },
         codegen_converter_cpp {},
     };
 #endif
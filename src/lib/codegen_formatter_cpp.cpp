@@ -1,14 +1,19 @@
 #include "spore/codegen/formatters/codegen_formatter_cpp.hpp"
 
+#include <algorithm>
 #include <filesystem>
+#include <string_view>
 
 #include "spore/codegen/codegen_macros.hpp"
 #include "spore/codegen/codegen_version.hpp"
+#include "spore/codegen/misc/current_path_scope.hpp"
+#include "spore/codegen/utils/files.hpp"
 
 #include "spdlog/spdlog.h"
 
 SPORE_CODEGEN_PUSH_DISABLE_WARNINGS
 #include "clang/Format/Format.h"
+#include "llvm/Config/llvm-config.h"
 SPORE_CODEGEN_POP_DISABLE_WARNINGS
 
 namespace spore::codegen
@@ -53,4 +58,53 @@ namespace spore::codegen
         return apply_reformat([]<typename... args_t>(args_t&&... args) { return clang::format::sortIncludes(std::forward<args_t>(args)...); }) and
                apply_reformat([]<typename... args_t>(args_t&&... args) { return clang::format::reformat(std::forward<args_t>(args)...); });
     }
+
+    // Style files are looked up the same way as `clang::format::getStyle` does, from the directory of the file up to the
+    // root, parent styles are only part of the fingerprint when the nearest one inherits from them.
+    std::string codegen_formatter_cpp::fingerprint(const std::string_view file)
+    {
+        const std::filesystem::path directory = current_path_scope::absolute(file).parent_path();
+        const auto it_fingerprint = _fingerprints.find(directory.string());
+
+        if (it_fingerprint != _fingerprints.end())
+        {
+            return it_fingerprint->second;
+        }
+
+        std::string fingerprint = LLVM_VERSION_STRING "\n";
+
+        for (std::filesystem::path style_directory = directory; !style_directory.empty(); style_directory = style_directory.parent_path())
+        {
+            constexpr std::string_view style_names[] {".clang-format", "_clang-format"};
+            std::string style;
+
+            const auto predicate = [&](const std::string_view style_name) {
+                return files::read_file((style_directory / style_name).string(), style);
+            };
+
+            if (std::ranges::any_of(style_names, predicate))
+            {
+                fingerprint += style;
+                fingerprint += '\n';
+
+                if (!style.contains("InheritParentConfig"))
+                {
+                    break;
+                }
+            }
+
+            if (style_directory == style_directory.root_path())
+            {
+                break;
+            }
+        }
+
+        _fingerprints.emplace(directory.string(), fingerprint);
+        return fingerprint;
+    }
+
+    std::unique_ptr<codegen_formatter> codegen_formatter_cpp::clone() const
+    {
+        return std::make_unique<codegen_formatter_cpp>(*this);
+    }
 }
\ No newline at end of file
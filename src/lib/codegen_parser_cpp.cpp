@@ -1,28 +1,54 @@
 #include "spore/codegen/parsers/cpp/codegen_parser_cpp.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
 #include <format>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "spdlog/spdlog.h"
 
 #include "spore/codegen/codegen_macros.hpp"
 #include "spore/codegen/codegen_version.hpp"
+#include "spore/codegen/misc/current_path_scope.hpp"
+#include "spore/codegen/misc/defer.hpp"
+#include "spore/codegen/misc/task_group.hpp"
+#include "spore/codegen/misc/thread_pool.hpp"
 #include "spore/codegen/parsers/cpp/codegen_utils_cpp.hpp"
+#include "spore/codegen/utils/files.hpp"
+#include "spore/codegen/utils/hashes.hpp"
 #include "spore/codegen/utils/strings.hpp"
 
 SPORE_CODEGEN_PUSH_DISABLE_WARNINGS
 #include "clang/AST/AST.h"
 #include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/Diagnostic.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendAction.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
 #include "clang/Lex/PreprocessorOptions.h"
-#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/CompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Config/llvm-config.h"
+#include "llvm/Support/VirtualFileSystem.h"
 SPORE_CODEGEN_POP_DISABLE_WARNINGS
 
 namespace spore::codegen
@@ -641,6 +667,155 @@ namespace spore::codegen
         {
             std::vector<cpp_file>& cpp_files;
             std::unordered_map<std::string, std::size_t>& cpp_file_map;
+            const codegen_parser_cpp::ast_callback_t& callback;
+            std::vector<std::string> include_paths;
+            std::unordered_map<std::string, std::vector<std::string>> file_includes;
+
+            // Files are resolved once per file id rather than once per declaration, most of them being headers of
+            // other libraries that are not inputs.
+            llvm::DenseMap<clang::FileID, cpp_file*> file_id_cpp_files;
+            llvm::DenseMap<clang::FileID, std::size_t> file_id_include_indices;
+
+            std::size_t next_file_index = 0;
+            std::exception_ptr exception;
+
+            // Set when clang could not use a precompiled header or another AST file, rather than failing on an input.
+            bool has_ast_file_error = false;
+
+            bool complete_files(const std::size_t file_index)
+            {
+                // Clang is not exception safe, errors are kept and rethrown once the tool has returned.
+                for (; next_file_index < std::min(file_index, cpp_files.size()); ++next_file_index)
+                {
+                    try
+                    {
+                        callback(std::move(cpp_files.at(next_file_index)));
+                    }
+                    catch (...)
+                    {
+                        exception = std::current_exception();
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            std::vector<std::string> get_dependencies(const std::string& file_path) const
+            {
+                if (file_path.empty())
+                {
+                    return {};
+                }
+
+                std::unordered_set<std::string> visited_paths {file_path};
+                std::vector<std::string> unvisited_paths {file_path};
+                std::vector<std::string> dependencies;
+
+                while (!unvisited_paths.empty())
+                {
+                    const std::string path = std::move(unvisited_paths.back());
+                    unvisited_paths.pop_back();
+
+                    const auto it_includes = file_includes.find(path);
+                    if (it_includes == file_includes.end())
+                    {
+                        continue;
+                    }
+
+                    for (const std::string& include : it_includes->second)
+                    {
+                        if (visited_paths.emplace(include).second)
+                        {
+                            dependencies.emplace_back(include);
+                            unvisited_paths.emplace_back(include);
+                        }
+                    }
+                }
+
+                std::ranges::sort(dependencies);
+                return dependencies;
+            }
+        };
+
+        // Records the user headers included by every file, system headers are left out like with `-MMD`. Headers
+        // are only entered once because of include guards, so the transitive includes of every input are resolved
+        // from the whole graph once the source file is preprocessed.
+        struct include_callbacks : clang::PPCallbacks
+        {
+            frontend_action_context& action_context;
+            const clang::SourceManager& source_manager;
+
+            explicit include_callbacks(frontend_action_context& action_context, const clang::SourceManager& source_manager)
+                : action_context(action_context),
+                  source_manager(source_manager)
+            {
+            }
+
+            void FileChanged(clang::SourceLocation location, FileChangeReason reason, clang::SrcMgr::CharacteristicKind file_type, clang::FileID previous_file_id) override
+            {
+                if (reason != EnterFile || file_type != clang::SrcMgr::C_User)
+                {
+                    return;
+                }
+
+                const clang::FileID file_id = source_manager.getFileID(location);
+                const clang::SourceLocation include_location = source_manager.getIncludeLoc(file_id);
+
+                if (include_location.isValid())
+                {
+                    add_include(include_location, get_file_path(source_manager.getFileEntryForID(file_id)));
+                }
+            }
+
+            void FileSkipped(const clang::FileEntryRef& skipped_file, const clang::Token& file_name_token, clang::SrcMgr::CharacteristicKind file_type) override
+            {
+                if (file_type == clang::SrcMgr::C_User)
+                {
+                    add_include(file_name_token.getLocation(), get_file_path(&skipped_file.getFileEntry()));
+                }
+            }
+
+            void add_include(const clang::SourceLocation include_location, std::string file_path)
+            {
+                if (file_path.empty())
+                {
+                    return;
+                }
+
+                const clang::FileID include_file_id = source_manager.getFileID(include_location);
+
+                if (include_file_id == source_manager.getMainFileID())
+                {
+                    // The source file has one include per line, in the same order as input files. Inputs are the roots
+                    // of the include graph, even when they were already included by a previous input.
+                    const std::size_t file_index = source_manager.getSpellingLineNumber(include_location) - 1;
+
+                    if (file_index < action_context.include_paths.size())
+                    {
+                        action_context.include_paths.at(file_index) = std::move(file_path);
+                    }
+
+                    return;
+                }
+
+                std::string include_file_path = get_file_path(source_manager.getFileEntryForID(include_file_id));
+
+                if (!include_file_path.empty())
+                {
+                    action_context.file_includes[std::move(include_file_path)].emplace_back(std::move(file_path));
+                }
+            }
+
+            static std::string get_file_path(const clang::FileEntry* file_entry)
+            {
+                if (file_entry == nullptr || file_entry->tryGetRealPathName().empty())
+                {
+                    return {};
+                }
+
+                return current_path_scope::absolute(file_entry->tryGetRealPathName().str()).string();
+            }
         };
 
         struct ast_visitor : clang::RecursiveASTVisitor<ast_visitor>
@@ -664,6 +839,28 @@ namespace spore::codegen
                 return false;
             }
 
+            // Declarations of files other than inputs, e.g. of the standard library, are skipped whole instead of being
+            // visited. Namespaces are still entered, since a file may include another one inside of them.
+            [[maybe_unused]] bool TraverseDecl(clang::Decl* decl)
+            {
+                if (decl != nullptr and not llvm::isa<clang::TranslationUnitDecl, clang::NamespaceDecl, clang::LinkageSpecDecl, clang::ExportDecl>(decl))
+                {
+                    const clang::DeclContext* context = decl->getDeclContext();
+
+                    if (context != nullptr and context->getRedeclContext()->isFileContext())
+                    {
+                        const clang::SourceManager& source_manager = ast_context.getSourceManager();
+
+                        if (find_cpp_file(source_manager.getExpansionLoc(decl->getLocation())) == nullptr)
+                        {
+                            return true;
+                        }
+                    }
+                }
+
+                return RecursiveASTVisitor::TraverseDecl(decl);
+            }
+
             [[maybe_unused]] bool VisitCXXRecordDecl(clang::CXXRecordDecl* decl)
             {
                 if (decl != nullptr and not decl->isUnion())
@@ -729,40 +926,158 @@ namespace spore::codegen
             }
 
             cpp_file* get_cpp_file(clang::Decl& decl)
+            {
+                return find_cpp_file(decl.getLocation());
+            }
+
+            cpp_file* find_cpp_file(const clang::SourceLocation location)
             {
                 const clang::SourceManager& source_manager = ast_context.getSourceManager();
-                const clang::SourceLocation location = decl.getLocation();
                 const clang::FileID file_id = source_manager.getFileID(location);
+                const auto [it_cpp_file, inserted] = action_context.file_id_cpp_files.try_emplace(file_id, nullptr);
+
+                if (!inserted)
+                {
+                    return it_cpp_file->second;
+                }
 
                 if (const clang::FileEntry* file_entry = source_manager.getFileEntryForID(file_id))
                 {
-                    const std::string file_path = std::filesystem::absolute(file_entry->tryGetRealPathName().str()).string();
+                    const std::string file_path = current_path_scope::absolute(file_entry->tryGetRealPathName().str()).string();
                     const auto it_file_map = action_context.cpp_file_map.find(file_path);
 
                     if (it_file_map != action_context.cpp_file_map.end())
                     {
                         const std::size_t file_index = it_file_map->second;
-                        return &action_context.cpp_files.at(file_index);
+                        it_cpp_file->second = &action_context.cpp_files.at(file_index);
                     }
                 }
 
-                return nullptr;
+                return it_cpp_file->second;
             }
         };
 
         struct ast_consumer : clang::ASTConsumer
         {
             frontend_action_context& action_context;
+            clang::ASTContext* ast_context = nullptr;
 
             explicit ast_consumer(frontend_action_context& action_context)
                 : action_context(action_context)
             {
             }
 
-            void HandleTranslationUnit(clang::ASTContext& ast_context) override
+            void Initialize(clang::ASTContext& context) override
+            {
+                ast_context = &context;
+            }
+
+            bool HandleTopLevelDecl(clang::DeclGroupRef decl_group) override
+            {
+                for (clang::Decl* decl : decl_group)
+                {
+                    // Input files are included in order by the source file, and each of them is included in full the
+                    // first time it is seen. Once a declaration comes from a later include, previous files are complete.
+                    if (!action_context.complete_files(get_include_index(*decl)))
+                    {
+                        return false;
+                    }
+
+                    ast_visitor visitor {action_context, *ast_context};
+                    visitor.TraverseDecl(decl);
+                }
+
+                return true;
+            }
+
+            void HandleTranslationUnit(clang::ASTContext& context) override
+            {
+                action_context.complete_files(action_context.cpp_files.size());
+            }
+
+            std::size_t get_include_index(const clang::Decl& decl) const
             {
-                ast_visitor visitor {action_context, ast_context};
-                visitor.TraverseAST(ast_context);
+                const clang::SourceManager& source_manager = ast_context->getSourceManager();
+                const clang::FileID file_id = source_manager.getFileID(source_manager.getExpansionLoc(decl.getLocation()));
+                const auto [it_include_index, inserted] = action_context.file_id_include_indices.try_emplace(file_id, 0);
+
+                if (inserted)
+                {
+                    it_include_index->second = find_include_index(file_id);
+                }
+
+                return it_include_index->second;
+            }
+
+            std::size_t find_include_index(clang::FileID file_id) const
+            {
+                const clang::SourceManager& source_manager = ast_context->getSourceManager();
+
+                while (file_id.isValid() && file_id != source_manager.getMainFileID())
+                {
+                    const clang::SourceLocation include_location = source_manager.getIncludeLoc(file_id);
+
+                    if (include_location.isInvalid())
+                    {
+                        break;
+                    }
+
+                    const clang::FileID include_file_id = source_manager.getFileID(include_location);
+
+                    if (include_file_id == source_manager.getMainFileID())
+                    {
+                        // The source file has one include per line, in the same order as input files.
+                        return source_manager.getSpellingLineNumber(include_location) - 1;
+                    }
+
+                    file_id = include_file_id;
+                }
+
+                return 0;
+            }
+        };
+
+        // Forwards every diagnostic to the client it replaces, errors of AST files such as precompiled headers, e.g. built
+        // by another version of clang or out-of-date, are all reported by the serialization component.
+        struct ast_file_diagnostic_consumer : clang::DiagnosticConsumer
+        {
+            frontend_action_context& action_context;
+            clang::DiagnosticConsumer& client;
+            std::unique_ptr<clang::DiagnosticConsumer> owned_client;
+
+            ast_file_diagnostic_consumer(frontend_action_context& action_context, clang::DiagnosticConsumer& client, std::unique_ptr<clang::DiagnosticConsumer> owned_client)
+                : action_context(action_context),
+                  client(client),
+                  owned_client(std::move(owned_client))
+            {
+            }
+
+            void BeginSourceFile(const clang::LangOptions& lang_options, const clang::Preprocessor* preprocessor) override
+            {
+                client.BeginSourceFile(lang_options, preprocessor);
+            }
+
+            void EndSourceFile() override
+            {
+                client.EndSourceFile();
+            }
+
+            void finish() override
+            {
+                client.finish();
+            }
+
+            void HandleDiagnostic(const clang::DiagnosticsEngine::Level level, const clang::Diagnostic& diagnostic) override
+            {
+                const unsigned id = diagnostic.getID();
+
+                if (level >= clang::DiagnosticsEngine::Error && id >= clang::diag::DIAG_START_SERIALIZATION && id < clang::diag::DIAG_START_LEX)
+                {
+                    action_context.has_ast_file_error = true;
+                }
+
+                clang::DiagnosticConsumer::HandleDiagnostic(level, diagnostic);
+                client.HandleDiagnostic(level, diagnostic);
             }
         };
 
@@ -788,6 +1103,15 @@ namespace spore::codegen
 
             std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance& compiler_instance, clang::StringRef file) override
             {
+                clang::Preprocessor& preprocessor = compiler_instance.getPreprocessor();
+                preprocessor.addPPCallbacks(std::make_unique<include_callbacks>(action_context, compiler_instance.getSourceManager()));
+
+                // The precompiled header is loaded once the consumer is created, before any input is parsed.
+                clang::DiagnosticsEngine& diagnostics_engine = compiler_instance.getDiagnostics();
+                clang::DiagnosticConsumer& client = *diagnostics_engine.getClient();
+                std::unique_ptr<clang::DiagnosticConsumer> owned_client = diagnostics_engine.takeClient();
+                diagnostics_engine.setClient(new ast_file_diagnostic_consumer {action_context, client, std::move(owned_client)}, true);
+
                 return std::make_unique<ast_consumer>(action_context);
             }
         };
@@ -806,66 +1130,620 @@ namespace spore::codegen
                 return std::make_unique<frontend_action>(action_context);
             }
         };
+
+        // Parses the files as a single translation unit, a virtual source file that includes each of them in order.
+        bool parse_unit(const std::filesystem::path& directory, const std::vector<std::string>& args, const std::span<const std::string> paths, const codegen_parser_cpp::ast_callback_t& callback, const codegen_parser_cpp::dependencies_callback_t& dependencies_callback, bool* has_ast_file_error = nullptr)
+        {
+            std::string cpp_source;
+            std::vector<cpp_file> cpp_files;
+            std::unordered_map<std::string, std::size_t> cpp_file_map;
+
+            cpp_files.reserve(paths.size());
+
+            for (const std::string& path : paths)
+            {
+                const std::size_t cpp_file_index = cpp_files.size();
+
+                cpp_file& cpp_file = cpp_files.emplace_back();
+                cpp_file.path = path;
+
+                strings::replace_all(cpp_file.path, "\\", "/");
+
+                std::string path_abs = current_path_scope::absolute(cpp_file.path).string();
+                cpp_file_map.emplace(std::move(path_abs), cpp_file_index);
+
+                cpp_source += std::format("#include \"{}\"\n", cpp_file.path);
+            }
+
+            const std::string cpp_source_path = (directory / "__source__.cpp").string();
+
+            // The compilation database and the file system are both bound to the current scope, so that clang never
+            // changes the working directory of the process, which would affect every other thread.
+            const clang::tooling::FixedCompilationDatabase compilations {directory.string(), args};
+
+            clang::tooling::ClangTool clang_tool {
+                compilations,
+                {cpp_source_path},
+                std::make_shared<clang::PCHContainerOperations>(),
+                llvm::vfs::createPhysicalFileSystem(),
+            };
+
+            clang_tool.mapVirtualFile(cpp_source_path, cpp_source);
+            clang_tool.setPrintErrorMessage(false);
+
+            frontend_action_context action_context {cpp_files, cpp_file_map, callback};
+            action_context.include_paths.resize(cpp_files.size());
+
+            frontend_action_factory action_factory {action_context};
+
+            const int action_result = clang_tool.run(&action_factory);
+
+            if (has_ast_file_error != nullptr)
+            {
+                *has_ast_file_error = action_context.has_ast_file_error;
+            }
+
+            if (action_context.exception != nullptr)
+            {
+                std::rethrow_exception(action_context.exception);
+            }
+
+            if (action_result == 0 && dependencies_callback != nullptr)
+            {
+                for (std::size_t cpp_file_index = 0; cpp_file_index < cpp_files.size(); ++cpp_file_index)
+                {
+                    dependencies_callback(cpp_file_index, action_context.get_dependencies(action_context.include_paths.at(cpp_file_index)));
+                }
+            }
+
+            return action_result == 0;
+        }
+
+        // Every unit parses the headers its files include, e.g. the standard library, units that are too small spend
+        // more time on these than they save.
+        constexpr std::size_t min_unit_size = 8;
+
+        // Thrown to a unit by the callback once another unit failed, so that it stops as soon as possible.
+        struct unit_cancelled
+        {
+        };
+
+        // Files of the units parsed on other threads, until every file before them was handed to the callback.
+        struct unit_results
+        {
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::vector<std::optional<cpp_file>> cpp_files;
+            std::vector<bool> completed_units;
+            std::vector<bool> parsed_units;
+            std::vector<std::exception_ptr> exceptions;
+            std::atomic<bool> cancelled = false;
+        };
+
+        struct cpp_preamble
+        {
+            std::string header;
+            std::string header_path;
+            std::string pch_path;
+            std::string manifest_path;
+            nlohmann::json manifest;
+            std::string digest;
+
+            // Files of the preamble changed since it was precompiled, empty when it is up-to-date or not precompiled yet.
+            std::string changes;
+
+            // Set once the preamble was checked and precompiled if needed, it is only used when it is valid.
+            bool is_built = false;
+            bool is_valid = false;
+
+            // Set once clang refused the precompiled header, the rest of the run parses without it.
+            std::atomic<bool> rejected = false;
+        };
+
+        struct cpp_preambles
+        {
+            std::mutex mutex;
+            std::map<std::string, cpp_preamble, std::less<>> preambles;
+        };
+
+        std::shared_ptr<cpp_preambles> make_cpp_preambles()
+        {
+            return std::make_shared<cpp_preambles>();
+        }
+
+        // Records every file the preamble is made of, system headers included, since the precompiled header is only
+        // valid as long as none of them changes.
+        struct preamble_callbacks : clang::PPCallbacks
+        {
+            std::vector<std::string>& file_paths;
+            const clang::SourceManager& source_manager;
+
+            explicit preamble_callbacks(std::vector<std::string>& file_paths, const clang::SourceManager& source_manager)
+                : file_paths(file_paths),
+                  source_manager(source_manager)
+            {
+            }
+
+            void FileChanged(clang::SourceLocation location, FileChangeReason reason, clang::SrcMgr::CharacteristicKind file_type, clang::FileID previous_file_id) override
+            {
+                if (reason != EnterFile)
+                {
+                    return;
+                }
+
+                std::string file_path = include_callbacks::get_file_path(source_manager.getFileEntryForID(source_manager.getFileID(location)));
+
+                if (!file_path.empty())
+                {
+                    file_paths.emplace_back(std::move(file_path));
+                }
+            }
+        };
+
+        struct preamble_action : clang::GeneratePCHAction
+        {
+            std::vector<std::string>& file_paths;
+
+            explicit preamble_action(std::vector<std::string>& file_paths)
+                : file_paths(file_paths)
+            {
+            }
+
+            std::unique_ptr<clang::ASTConsumer> CreateASTConsumer(clang::CompilerInstance& compiler_instance, clang::StringRef file) override
+            {
+                compiler_instance.getDiagnostics().setSuppressAllDiagnostics(true);
+                compiler_instance.getPreprocessor().addPPCallbacks(std::make_unique<preamble_callbacks>(file_paths, compiler_instance.getSourceManager()));
+
+                return GeneratePCHAction::CreateASTConsumer(compiler_instance, file);
+            }
+        };
+
+        struct preamble_action_factory : clang::tooling::FrontendActionFactory
+        {
+            std::vector<std::string>& file_paths;
+
+            explicit preamble_action_factory(std::vector<std::string>& file_paths)
+                : file_paths(file_paths)
+            {
+            }
+
+            std::unique_ptr<clang::FrontendAction> create() override
+            {
+                return std::make_unique<preamble_action>(file_paths);
+            }
+        };
+
+        // The manifest lists the files of the preamble along with their size and modification time, the same
+        // metadata clang checks before using a precompiled header. Files that changed are listed with their new
+        // metadata, so that each change of the preamble gives other changes.
+        std::string find_preamble_changes(const nlohmann::json& manifest)
+        {
+            std::string changes;
+
+            if (!manifest.is_object() || !manifest.contains("files"))
+            {
+                return changes;
+            }
+
+            for (const nlohmann::json& file : manifest["files"])
+            {
+                const std::string path = file.value("path", "");
+                files::file_stat stat;
+
+                if (!files::stat_file(path, stat))
+                {
+                    changes += std::format("{} missing\n", path);
+                }
+                else if (stat.size != file.value("size", std::size_t {0}) || stat.mtime != file.value("mtime", std::int64_t {0}))
+                {
+                    changes += std::format("{} {} {}\n", path, stat.size, stat.mtime);
+                }
+            }
+
+            return changes;
+        }
+
+        bool make_preamble(const std::filesystem::path& directory, const std::vector<std::string>& args, const std::string& header_path, const std::string& pch_path, nlohmann::json& manifest)
+        {
+            std::vector<std::string> pch_args = args;
+            pch_args.insert(pch_args.end(), {"-xc++-header", "-o", pch_path});
+
+            const clang::tooling::FixedCompilationDatabase compilations {directory.string(), pch_args};
+
+            clang::tooling::ClangTool clang_tool {
+                compilations,
+                {header_path},
+                std::make_shared<clang::PCHContainerOperations>(),
+                llvm::vfs::createPhysicalFileSystem(),
+            };
+
+            // The default adjusters would strip the output file and only check the syntax.
+            clang_tool.clearArgumentsAdjusters();
+            clang_tool.setPrintErrorMessage(false);
+
+            std::vector<std::string> file_paths;
+            preamble_action_factory action_factory {file_paths};
+
+            if (clang_tool.run(&action_factory) != 0)
+            {
+                return false;
+            }
+
+            std::ranges::sort(file_paths);
+            file_paths.erase(std::ranges::unique(file_paths).begin(), file_paths.end());
+
+            manifest = {{"files", nlohmann::json::array()}};
+
+            for (const std::string& file_path : file_paths)
+            {
+                files::file_stat stat;
+
+                if (!files::stat_file(file_path, stat))
+                {
+                    return false;
+                }
+
+                manifest["files"].push_back({{"path", file_path}, {"size", stat.size}, {"mtime", stat.mtime}});
+            }
+
+            return true;
+        }
+
+        // Files of a preamble are named after everything that goes in it other than the content of its headers, so
+        // that runs with other arguments or in other directories do not replace each other's preamble. Only the
+        // manifest is read, the preamble is precompiled by `build_preamble` once files are parsed.
+        void init_preamble(const std::filesystem::path& directory, const std::vector<std::string>& args, const std::vector<std::string>& preamble, const std::string& preamble_path, cpp_preamble& cpp_preamble)
+        {
+            for (const std::string& include : preamble)
+            {
+                const bool is_delimited = include.starts_with('<') || include.starts_with('"');
+                cpp_preamble.header += is_delimited ? std::format("#include {}\n", include) : std::format("#include <{}>\n", include);
+            }
+
+            std::string key_data = directory.string() + '\n' + cpp_preamble.header;
+
+            for (const std::string& arg : args)
+            {
+                key_data += arg;
+                key_data += '\n';
+            }
+
+            const std::string base_path = std::format("{}.cpp-{:016x}", preamble_path, XXH3_64bits(key_data.data(), key_data.size()));
+            cpp_preamble.header_path = base_path + ".hpp";
+            cpp_preamble.pch_path = base_path + ".pch";
+            cpp_preamble.manifest_path = base_path + ".json";
+
+            if (files::read_file(cpp_preamble.manifest_path, cpp_preamble.manifest))
+            {
+                const std::string manifest_data = cpp_preamble.manifest.dump();
+                cpp_preamble.digest = std::format("{:016x}", XXH3_64bits(manifest_data.data(), manifest_data.size()));
+                cpp_preamble.changes = find_preamble_changes(cpp_preamble.manifest);
+            }
+            else
+            {
+                cpp_preamble.manifest = nullptr;
+            }
+        }
+
+        void build_preamble(const std::filesystem::path& directory, const std::vector<std::string>& args, cpp_preamble& cpp_preamble)
+        {
+            cpp_preamble.is_built = true;
+
+            bool changed = false;
+            if (!files::write_file_if_changed(cpp_preamble.header_path, cpp_preamble.header, changed))
+            {
+                SPDLOG_WARN("failed to write preamble, file={}", cpp_preamble.header_path);
+                return;
+            }
+
+            files::file_stat pch_stat;
+
+            if (changed || cpp_preamble.manifest.is_null() || !cpp_preamble.changes.empty() || !files::stat_file(cpp_preamble.pch_path, pch_stat))
+            {
+                SPDLOG_INFO("precompiling preamble, file={}", cpp_preamble.pch_path);
+
+                nlohmann::json manifest;
+
+                if (!make_preamble(directory, args, cpp_preamble.header_path, cpp_preamble.pch_path, manifest) || !files::write_file(cpp_preamble.manifest_path, manifest))
+                {
+                    SPDLOG_WARN("failed to precompile preamble, parsing without it, file={}", cpp_preamble.pch_path);
+                    return;
+                }
+
+                const std::string manifest_data = manifest.dump();
+                cpp_preamble.manifest = std::move(manifest);
+                cpp_preamble.digest = std::format("{:016x}", XXH3_64bits(manifest_data.data(), manifest_data.size()));
+                cpp_preamble.changes.clear();
+            }
+
+            cpp_preamble.is_valid = true;
+        }
+
+        // Must be called with the mutex of the preambles held.
+        cpp_preamble& find_preamble(cpp_preambles& preambles, const std::vector<std::string>& args, const std::vector<std::string>& preamble, const std::string& preamble_path)
+        {
+            const std::string directory = current_path_scope::current_path().string();
+            auto [it_preamble, inserted] = preambles.preambles.try_emplace(directory);
+
+            if (inserted)
+            {
+                init_preamble(directory, args, preamble, preamble_path, it_preamble->second);
+            }
+
+            return it_preamble->second;
+        }
     }
 
-    bool codegen_parser_cpp::parse_asts(const std::vector<std::string>& paths, std::vector<cpp_file>& cpp_files)
+    bool codegen_parser_cpp::parse_asts(const std::vector<std::string>& paths, const ast_callback_t& callback, const dependencies_callback_t& dependencies_callback)
     {
-        constexpr std::size_t extra_args = 3;
+        const std::filesystem::path directory = current_path_scope::current_path();
+        const std::vector<std::string> args = make_args();
+        detail::cpp_preamble* preamble = get_preamble(args);
 
-        std::vector<const char*> args;
-        args.reserve(paths.size() + additional_args.size() + extra_args);
+        std::vector<std::string> preamble_args = args;
 
-        const auto transformer = [](const std::string& arg) { return arg.data(); };
+        if (preamble != nullptr)
+        {
+            preamble_args.insert(preamble_args.end(), {"-include-pch", preamble->pch_path});
+        }
+
+        // A precompiled header that clang refuses, e.g. built by another version of clang, fails the unit before any
+        // file is complete, the unit is then parsed again without it. Units that fail on their inputs keep it.
+        const auto parse_unit = [&](const std::span<const std::string> unit_paths, const ast_callback_t& unit_callback, const dependencies_callback_t& unit_dependencies_callback) {
+            if (preamble == nullptr || preamble->rejected)
+            {
+                return detail::parse_unit(directory, args, unit_paths, unit_callback, unit_dependencies_callback);
+            }
 
-        args.emplace_back(SPORE_CODEGEN_NAME);
+            bool has_files = false;
 
-        std::ranges::transform(paths, std::back_inserter(args), transformer);
+            const auto preamble_callback = [&](cpp_file&& cpp_file) {
+                has_files = true;
+                unit_callback(std::move(cpp_file));
+            };
 
-        args.emplace_back("--");
-        args.emplace_back("--target=" LLVM_HOST_TRIPLE);
+            bool has_ast_file_error = false;
+            const bool parsed = detail::parse_unit(directory, preamble_args, unit_paths, preamble_callback, unit_dependencies_callback, &has_ast_file_error);
 
-        std::ranges::transform(additional_args, std::back_inserter(args), transformer);
+            if (parsed || has_files || !has_ast_file_error)
+            {
+                return parsed;
+            }
 
-        int args_size = args.size();
+            SPDLOG_DEBUG("preamble rejected, parsing without it, file={}", preamble->pch_path);
+            preamble->rejected = true;
+            return detail::parse_unit(directory, args, unit_paths, unit_callback, unit_dependencies_callback);
+        };
 
-        llvm::cl::OptionCategory option_category {SPORE_CODEGEN_NAME};
-        llvm::Expected<clang::tooling::CommonOptionsParser> options_parser =
-            clang::tooling::CommonOptionsParser::create(args_size, args.data(), option_category);
+        const std::size_t unit_count = std::clamp<std::size_t>(paths.size() / detail::min_unit_size, 1, _pool != nullptr ? _pool->size() : jobs);
 
-        if (!options_parser)
+        if (unit_count == 1)
         {
-            SPDLOG_ERROR("invalid clang options: {}", llvm::toString(options_parser.takeError()));
-            return false;
+            return parse_unit(paths, callback, dependencies_callback);
         }
 
-        std::string cpp_source;
-        std::unordered_map<std::string, std::size_t> cpp_file_map;
+        SPDLOG_DEBUG("parsing translation units, files={} units={}", paths.size(), unit_count);
+
+        // Parsers used on their own, e.g. in tests, have no pool shared with them and parse units on one of their own.
+        std::optional<thread_pool> own_pool;
+        thread_pool& pool = _pool != nullptr ? *_pool : own_pool.emplace(unit_count);
 
-        for (const std::string& cpp_source_file : options_parser->getSourcePathList())
+        // Units are contiguous ranges of the paths, which keeps files of the same directory, that tend to include the
+        // same headers, in the same unit. The first unit is parsed on this thread, files of the other units are handed
+        // to the callback on this thread as well, once every file before them was, so that files are seen in the same
+        // order as with a single unit.
+        const auto get_unit_begin = [&](const std::size_t unit_index) { return paths.size() * unit_index / unit_count; };
+
+        detail::unit_results results;
+        results.cpp_files.resize(paths.size());
+        results.completed_units.resize(unit_count);
+        results.parsed_units.resize(unit_count);
+        results.exceptions.resize(unit_count);
+
+        std::vector<std::vector<std::string>> dependencies(paths.size());
+        task_group unit_group {pool};
+
+        // Units still running when this thread leaves, e.g. because of an error, are cancelled before being waited on.
+        defer cancel_units = [&] { results.cancelled = true; };
+
+        // This thread may itself be a task of the pool, e.g. a stage, it runs other tasks while it waits on units so
+        // that units queued behind busy workers cannot starve it.
+        const auto wait_results = [&](const auto& predicate) {
+            std::unique_lock lock {results.mutex};
+
+            while (!predicate())
+            {
+                lock.unlock();
+                const bool has_run = pool.run_pending_task();
+                lock.lock();
+
+                // Units are queued before any wait, once the queue is empty, every unit left is running.
+                if (!has_run)
+                {
+                    results.condition.wait(lock, predicate);
+                }
+            }
+        };
+
+        for (std::size_t unit_index = 1; unit_index < unit_count; ++unit_index)
         {
-            const std::size_t cpp_file_index = cpp_files.size();
+            unit_group.run([&, unit_index] {
+                current_path_scope directory_scope {directory};
 
-            cpp_file& cpp_file = cpp_files.emplace_back();
-            cpp_file.path = cpp_source_file;
+                const std::size_t unit_begin = get_unit_begin(unit_index);
+                const std::size_t unit_end = get_unit_begin(unit_index + 1);
+                std::size_t next_file_index = unit_begin;
 
-            strings::replace_all(cpp_file.path, "\\", "/");
+                const auto unit_callback = [&](cpp_file&& cpp_file) {
+                    if (results.cancelled)
+                    {
+                        throw detail::unit_cancelled {};
+                    }
+
+                    {
+                        std::scoped_lock lock {results.mutex};
+                        results.cpp_files.at(next_file_index++) = std::move(cpp_file);
+                    }
+
+                    results.condition.notify_all();
+                };
+
+                const auto unit_dependencies_callback = [&](const std::size_t path_index, std::vector<std::string>&& path_dependencies) {
+                    dependencies.at(unit_begin + path_index) = std::move(path_dependencies);
+                };
+
+                bool parsed = false;
+                std::exception_ptr exception;
+
+                try
+                {
+                    const std::span<const std::string> unit_paths {paths.begin() + unit_begin, paths.begin() + unit_end};
+                    parsed = parse_unit(unit_paths, unit_callback, unit_dependencies_callback);
+                }
+                catch (const detail::unit_cancelled&)
+                {
+                }
+                catch (...)
+                {
+                    exception = std::current_exception();
+                }
 
-            std::string path_abs = std::filesystem::absolute(cpp_file.path).string();
-            cpp_file_map.emplace(std::move(path_abs), cpp_file_index);
+                {
+                    std::scoped_lock lock {results.mutex};
+                    results.completed_units.at(unit_index) = true;
+                    results.parsed_units.at(unit_index) = parsed;
+                    results.exceptions.at(unit_index) = exception;
+                }
 
-            cpp_source += std::format("#include \"{}\"\n", cpp_file.path);
+                results.condition.notify_all();
+            });
         }
 
-        constexpr const char cpp_source_path[] = "__source__.cpp";
+        const auto first_dependencies_callback = [&](const std::size_t path_index, std::vector<std::string>&& path_dependencies) {
+            dependencies.at(path_index) = std::move(path_dependencies);
+        };
 
-        clang::tooling::ClangTool clang_tool {options_parser->getCompilations(), {std::string {cpp_source_path}}};
-        clang_tool.mapVirtualFile(cpp_source_path, cpp_source);
-        clang_tool.setPrintErrorMessage(false);
+        const std::span<const std::string> first_paths {paths.begin(), paths.begin() + get_unit_begin(1)};
+        bool parsed = parse_unit(first_paths, callback, first_dependencies_callback);
+
+        for (std::size_t unit_index = 1; unit_index < unit_count; ++unit_index)
+        {
+            for (std::size_t file_index = get_unit_begin(unit_index); file_index < get_unit_begin(unit_index + 1); ++file_index)
+            {
+                wait_results([&] { return results.cpp_files.at(file_index).has_value() || results.completed_units.at(unit_index); });
+
+                std::optional<cpp_file> cpp_file;
+
+                {
+                    std::scoped_lock lock {results.mutex};
+                    cpp_file = std::exchange(results.cpp_files.at(file_index), std::nullopt);
+                }
+
+                // Files are only missing when their unit failed before completing them.
+                if (cpp_file.has_value())
+                {
+                    callback(std::move(cpp_file.value()));
+                }
+            }
+
+            wait_results([&] { return results.completed_units.at(unit_index); });
+
+            std::scoped_lock lock {results.mutex};
+
+            if (results.exceptions.at(unit_index) != nullptr)
+            {
+                std::rethrow_exception(results.exceptions.at(unit_index));
+            }
+
+            parsed = parsed && results.parsed_units.at(unit_index);
+        }
+
+        if (parsed && dependencies_callback != nullptr)
+        {
+            for (std::size_t path_index = 0; path_index < paths.size(); ++path_index)
+            {
+                dependencies_callback(path_index, std::move(dependencies.at(path_index)));
+            }
+        }
+
+        return parsed;
+    }
+
+    std::string codegen_parser_cpp::fingerprint() const
+    {
+        std::string fingerprint = LLVM_VERSION_STRING "\n" LLVM_HOST_TRIPLE "\n";
+
+        for (const std::string& additional_arg : additional_args)
+        {
+            fingerprint += additional_arg;
+            fingerprint += '\n';
+        }
+
+        for (const std::string& include : preamble)
+        {
+            fingerprint += include;
+            fingerprint += '\n';
+        }
+
+        // Inputs are not told apart from the headers of the preamble they include, changes of these headers are found
+        // through the preamble instead. Its files are only checked here, it is precompiled once inputs are parsed and
+        // the fingerprint then changes to the one of the precompiled preamble.
+        fingerprint += get_preamble_digest(make_args());
+
+        return fingerprint;
+    }
+
+    cpp_file codegen_parser_cpp::make_empty_ast(const std::string& path) const
+    {
+        cpp_file cpp_file;
+        cpp_file.path = path;
+
+        strings::replace_all(cpp_file.path, "\\", "/");
+        return cpp_file;
+    }
+
+    void codegen_parser_cpp::share_pool(thread_pool& pool)
+    {
+        _pool = &pool;
+    }
+
+    std::vector<std::string> codegen_parser_cpp::make_args() const
+    {
+        std::vector<std::string> args;
+        args.reserve(additional_args.size() + 1);
+        args.emplace_back("--target=" LLVM_HOST_TRIPLE);
+        args.insert(args.end(), additional_args.begin(), additional_args.end());
+        return args;
+    }
+
+    detail::cpp_preamble* codegen_parser_cpp::get_preamble(const std::vector<std::string>& args) const
+    {
+        if (preamble.empty() || preamble_path.empty())
+        {
+            return nullptr;
+        }
+
+        std::scoped_lock lock {_preambles->mutex};
+        detail::cpp_preamble& cpp_preamble = detail::find_preamble(*_preambles, args, preamble, preamble_path);
+
+        if (!cpp_preamble.is_built)
+        {
+            detail::build_preamble(current_path_scope::current_path(), args, cpp_preamble);
+        }
+
+        return cpp_preamble.is_valid ? &cpp_preamble : nullptr;
+    }
+
+    std::string codegen_parser_cpp::get_preamble_digest(const std::vector<std::string>& args) const
+    {
+        if (preamble.empty() || preamble_path.empty())
+        {
+            return {};
+        }
 
-        detail::frontend_action_context action_context {cpp_files, cpp_file_map};
-        detail::frontend_action_factory action_factory {action_context};
+        std::scoped_lock lock {_preambles->mutex};
+        const detail::cpp_preamble& cpp_preamble = detail::find_preamble(*_preambles, args, preamble, preamble_path);
 
-        const int action_result = clang_tool.run(&action_factory);
-        return action_result == 0;
+        return std::format("{}\n{}", cpp_preamble.digest, cpp_preamble.changes);
     }
-}
+}
\ No newline at end of file
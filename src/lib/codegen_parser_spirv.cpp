@@ -6,9 +6,10 @@
 #include "spdlog/spdlog.h"
 #include "spirv_reflect.h"
 
+#include "spore/codegen/misc/current_path_scope.hpp"
 #include "spore/codegen/misc/defer.hpp"
 #include "spore/codegen/misc/make_unique_id.hpp"
-#include "spore/codegen/utils/files.hpp"
+#include "spore/codegen/misc/mapped_file.hpp"
 
 namespace spore::codegen
 {
@@ -371,15 +372,18 @@ namespace spore::codegen
 
         bool parse_ast(const std::string_view path, spirv_module& module)
         {
+            // Names made for unnamed values only depend on the module, not on the other modules parsed before it.
+            unique_id_scope id_scope;
             SpvReflectShaderModule spv_module {};
+            mapped_file file;
 
-            if (!files::read_file(path, module.byte_code))
+            if (!file.open(current_path_scope::absolute(path)))
             {
                 SPDLOG_ERROR("cannot read SPIR-V file, path={}", path);
                 return false;
             }
 
-            const SpvReflectResult spv_result = spvReflectCreateShaderModule(module.byte_code.size(), module.byte_code.data(), &spv_module);
+            const SpvReflectResult spv_result = spvReflectCreateShaderModule(file.size(), file.bytes().data(), &spv_module);
             if (spv_result != SPV_REFLECT_RESULT_SUCCESS) [[unlikely]]
             {
                 SPDLOG_ERROR("SPIR-V reflection failed, path={} result={}", path, static_cast<std::int32_t>(spv_result));
@@ -388,21 +392,25 @@ namespace spore::codegen
 
             defer destroy_module = [&] { spvReflectDestroyShaderModule(&spv_module); };
             detail::to_module(path, spv_module, module);
+
+            // The module owns its byte code, it is copied once from the mapped file.
+            module.byte_code.assign(file.bytes().begin(), file.bytes().end());
             return true;
         }
     }
 
-    bool codegen_parser_spirv::parse_asts(const std::vector<std::string>& paths, std::vector<spirv_module>& modules)
+    bool codegen_parser_spirv::parse_asts(const std::vector<std::string>& paths, const ast_callback_t& callback, const dependencies_callback_t& dependencies_callback)
     {
-        modules.clear();
-        modules.reserve(paths.size());
-
         for (const std::string& path : paths)
         {
-            if (!detail::parse_ast(path, modules.emplace_back()))
+            spirv_module module;
+
+            if (!detail::parse_ast(path, module))
             {
                 return false;
             }
+
+            callback(std::move(module));
         }
 
         return true;
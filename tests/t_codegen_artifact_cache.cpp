@@ -0,0 +1,105 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "catch2/catch_all.hpp"
+
+#include "spore/codegen/codegen_artifact_cache.hpp"
+
+TEST_CASE("spore::codegen::codegen_artifact_cache", "[spore::codegen][spore::codegen::codegen_artifact_cache]")
+{
+    using namespace spore::codegen;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "spore-codegen-t-codegen-artifact-cache";
+    std::filesystem::remove_all(directory);
+
+    const codegen_artifact_cache artifact_cache {directory.string(), hashes::hash_algorithm::xxh3};
+    const std::string key = artifact_cache.make_key({"input", "file.txt"});
+
+    SECTION("make different keys for different parts")
+    {
+        REQUIRE(artifact_cache.make_key({"input", "file.txt"}) == key);
+        REQUIRE(artifact_cache.make_key({"inputfile.txt"}) != key);
+        REQUIRE(artifact_cache.make_key({"inputfile", ".txt"}) != key);
+    }
+
+    SECTION("read and write outputs")
+    {
+        std::string content;
+        REQUIRE_FALSE(artifact_cache.read(key, content));
+
+        REQUIRE(artifact_cache.write(key, std::string {"content\r\n"}));
+        REQUIRE(artifact_cache.read(key, content));
+        REQUIRE(content == "content\r\n");
+    }
+
+    SECTION("read and write inputs")
+    {
+        const codegen_input_artifact artifact {
+            .key = key,
+            .dependencies = {{.path = "include/file.h", .hash = hashes::hash(hashes::hash_algorithm::xxh3, "content")}},
+            .step_indices = {0, 2},
+            .data = {{"name", "file"}},
+        };
+
+        REQUIRE(artifact_cache.write(key, artifact));
+
+        codegen_input_artifact read_artifact;
+        REQUIRE(artifact_cache.read(key, read_artifact));
+        REQUIRE(read_artifact.dependencies.size() == 1);
+        REQUIRE(read_artifact.dependencies.at(0).path == artifact.dependencies.at(0).path);
+        REQUIRE(read_artifact.dependencies.at(0).hash == artifact.dependencies.at(0).hash);
+        REQUIRE(read_artifact.step_indices == artifact.step_indices);
+        REQUIRE(read_artifact.data == artifact.data);
+    }
+
+    SECTION("read inputs stored under another name only with the same key")
+    {
+        const std::string name = artifact_cache.make_key({"slot", "file.txt"});
+
+        const codegen_input_artifact artifact {
+            .key = key,
+            .data = {{"name", "file"}},
+        };
+
+        REQUIRE(artifact_cache.write(name, artifact));
+
+        codegen_input_artifact read_artifact;
+        REQUIRE(artifact_cache.read(name, key, read_artifact));
+        REQUIRE(read_artifact.data == artifact.data);
+        REQUIRE_FALSE(artifact_cache.read(name, artifact_cache.make_key({"input", "other.txt"}), read_artifact));
+        REQUIRE_FALSE(artifact_cache.read(key, read_artifact));
+    }
+
+    SECTION("ignore invalid inputs")
+    {
+        REQUIRE(artifact_cache.write(key, std::string {"invalid"}));
+
+        codegen_input_artifact artifact;
+        REQUIRE_FALSE(artifact_cache.read(key, artifact));
+    }
+
+    SECTION("refresh the modification time of artifacts read")
+    {
+        REQUIRE(artifact_cache.write(key, std::string {"content"}));
+
+        std::filesystem::path path;
+
+        for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(directory))
+        {
+            if (entry.is_regular_file())
+            {
+                path = entry.path();
+            }
+        }
+
+        const std::filesystem::file_time_type old_time = std::filesystem::file_time_type::clock::now() - std::chrono::days(30);
+        std::filesystem::last_write_time(path, old_time);
+
+        std::string content;
+        REQUIRE(artifact_cache.read(key, content));
+        REQUIRE(std::filesystem::last_write_time(path) > old_time);
+    }
+
+    std::filesystem::remove_all(directory);
+}
\ No newline at end of file
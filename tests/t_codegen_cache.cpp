@@ -0,0 +1,319 @@
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "spore/codegen/codegen_cache.hpp"
+
+TEST_CASE("spore::codegen::codegen_cache", "[spore::codegen][spore::codegen::codegen_cache]")
+{
+    using namespace spore::codegen;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "spore-codegen-t-codegen-cache";
+    const std::string path = (directory / "file.txt").string();
+
+    std::filesystem::remove_all(directory);
+    REQUIRE(files::write_file(path, std::string {"content"}));
+
+    codegen_cache cache;
+
+    SECTION("check new, unchanged and changed files")
+    {
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::up_to_date);
+
+        REQUIRE(files::write_file(path, std::string {"other content"}));
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::dirty);
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::up_to_date);
+    }
+
+    SECTION("keep files up-to-date when only their metadata changed")
+    {
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+
+        REQUIRE(files::write_file(path, std::string {"content"}));
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::up_to_date);
+    }
+
+    SECTION("check files without updating the cache")
+    {
+        const codegen_cache_check check = codegen_cache::check(path, nullptr, cache.algorithm);
+        REQUIRE(check.status == codegen_cache_status::new_);
+        REQUIRE(check.entry.has_value());
+        REQUIRE(cache.empty());
+
+        REQUIRE(cache.update(check) == codegen_cache_status::new_);
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::up_to_date);
+    }
+
+    SECTION("record file metadata")
+    {
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+
+        files::file_stat stat;
+        REQUIRE(files::stat_file(path, stat));
+
+        const std::optional<codegen_cache_entry> entry = cache.find(path);
+        REQUIRE(entry.has_value());
+        REQUIRE(entry->size == stat.size);
+        REQUIRE(entry->ctime == stat.ctime);
+        REQUIRE(entry->inode == stat.inode);
+    }
+
+    SECTION("read and write cache files")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+        REQUIRE(files::write_file(other_path, std::string {"other content"}));
+
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(cache.check_and_update(other_path) == codegen_cache_status::new_);
+        REQUIRE(cache.update_dependencies(path, {other_path}));
+        REQUIRE(cache.update_outputs(path, {other_path}));
+        cache.update_output(other_path, hashes::hash(cache.algorithm, std::string_view {"key"}), hashes::hash(cache.algorithm, std::string_view {"other content"}));
+        cache.update_fingerprint("stage", hashes::hash(cache.algorithm, std::string_view {"config"}));
+
+        for (const std::string_view extension : {".cache", ".json", ".yml"})
+        {
+            const std::string cache_path = (directory / "cache").replace_extension(extension).string();
+            REQUIRE(cache.write(cache_path));
+
+            codegen_cache other_cache;
+            REQUIRE(other_cache.read(cache_path));
+            REQUIRE(other_cache.version == cache.version);
+            REQUIRE(other_cache.algorithm == cache.algorithm);
+            REQUIRE(other_cache.find(path)->hash == cache.find(path)->hash);
+            REQUIRE(other_cache.find(other_path)->hash == cache.find(other_path)->hash);
+            REQUIRE(other_cache.find(path)->dependencies == std::vector {other_path});
+            REQUIRE(other_cache.find(other_path)->dependencies.empty());
+            REQUIRE(other_cache.find(other_path)->key == cache.find(other_path)->key);
+            REQUIRE(other_cache.find(path)->key.empty());
+            REQUIRE(other_cache.find(path)->outputs == std::vector {other_path});
+            REQUIRE(other_cache.find(other_path)->outputs.empty());
+            REQUIRE(other_cache.find(other_path)->output_hash == other_cache.find(other_path)->hash);
+            REQUIRE(other_cache.find(path)->output_hash.empty());
+            REQUIRE_FALSE(other_cache.find(directory.string()).has_value());
+            REQUIRE(other_cache.find_fingerprint("stage") == cache.find_fingerprint("stage"));
+            REQUIRE_FALSE(other_cache.find_fingerprint("other stage").has_value());
+        }
+    }
+
+    SECTION("keep dependencies until files are parsed again")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+        REQUIRE(files::write_file(other_path, std::string {"other content"}));
+
+        REQUIRE_FALSE(cache.update_dependencies(path, {other_path}));
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(cache.update_dependencies(path, {other_path}));
+
+        REQUIRE(files::write_file(path, std::string {"changed content"}));
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::dirty);
+        REQUIRE(cache.find(path)->dependencies == std::vector {other_path});
+    }
+
+    SECTION("keep output keys of files checked as inputs")
+    {
+        cache.update_output(path, hashes::hash(cache.algorithm, std::string_view {"key"}), hashes::hash(cache.algorithm, std::string_view {"content"}));
+        REQUIRE(cache.find(path)->hash.empty());
+
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::dirty);
+        REQUIRE_FALSE(cache.find(path)->hash.empty());
+        REQUIRE(cache.find(path)->key == hashes::hash(cache.algorithm, std::string_view {"key"}));
+        REQUIRE(cache.find(path)->output_hash == cache.find(path)->hash);
+    }
+
+    SECTION("find outputs modified since they were written")
+    {
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        cache.update_output(path, hashes::hash(cache.algorithm, std::string_view {"key"}), cache.find(path)->hash);
+
+        REQUIRE(files::write_file(path, std::string {"modified content"}));
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::dirty);
+        REQUIRE(cache.find(path)->output_hash != cache.find(path)->hash);
+    }
+
+    SECTION("keep outputs until files are rendered again")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+
+        REQUIRE_FALSE(cache.update_outputs(path, {other_path}));
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(cache.update_outputs(path, {other_path}));
+
+        REQUIRE(files::write_file(path, std::string {"changed content"}));
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::dirty);
+        REQUIRE(cache.find(path)->outputs == std::vector {other_path});
+    }
+
+    SECTION("prune entries of deleted files")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+        const std::string cache_path = (directory / ".codegen.cache").string();
+        REQUIRE(files::write_file(other_path, std::string {"other content"}));
+
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(cache.check_and_update(other_path) == codegen_cache_status::new_);
+        REQUIRE(cache.write(cache_path));
+
+        std::filesystem::remove(other_path);
+
+        codegen_cache other_cache;
+        REQUIRE(other_cache.read(cache_path));
+        REQUIRE(other_cache.write(cache_path));
+        REQUIRE(other_cache.read(cache_path));
+        REQUIRE(other_cache.find(path).has_value());
+        REQUIRE_FALSE(other_cache.find(other_path).has_value());
+    }
+
+    SECTION("journal updates until the cache is compacted")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+        const std::string cache_path = (directory / ".codegen.cache").string();
+        const std::string journal_path = cache_path + ".journal";
+        REQUIRE(files::write_file(other_path, std::string {"other content"}));
+
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(cache.write(cache_path));
+
+        codegen_cache other_cache;
+        REQUIRE(other_cache.read(cache_path));
+        REQUIRE(files::write_file(path, std::string {"changed content"}));
+        REQUIRE(other_cache.check_and_update(path) == codegen_cache_status::dirty);
+        REQUIRE(other_cache.check_and_update(other_path) == codegen_cache_status::new_);
+        REQUIRE(other_cache.flush(cache_path, [&](const std::string& file) { return file != other_path; }));
+        REQUIRE(std::filesystem::exists(journal_path));
+
+        codegen_cache journal_cache;
+        REQUIRE(journal_cache.read(cache_path));
+        REQUIRE(journal_cache.find(path)->hash == other_cache.find(path)->hash);
+        REQUIRE_FALSE(journal_cache.find(other_path).has_value());
+
+        REQUIRE(other_cache.save(cache_path));
+        REQUIRE(journal_cache.read(cache_path));
+        REQUIRE(journal_cache.find(other_path)->hash == other_cache.find(other_path)->hash);
+
+        REQUIRE(other_cache.write(cache_path));
+        REQUIRE_FALSE(std::filesystem::exists(journal_path));
+        REQUIRE(journal_cache.read(cache_path));
+        REQUIRE(journal_cache.find(path)->hash == other_cache.find(path)->hash);
+        REQUIRE(journal_cache.find(other_path)->hash == other_cache.find(other_path)->hash);
+    }
+
+    SECTION("journal fingerprints")
+    {
+        const std::string cache_path = (directory / ".codegen.cache").string();
+
+        cache.update_fingerprint("stage", hashes::hash(cache.algorithm, std::string_view {"config"}));
+        REQUIRE(cache.write(cache_path));
+
+        codegen_cache other_cache;
+        REQUIRE(other_cache.read(cache_path));
+        other_cache.update_fingerprint("stage", hashes::hash(cache.algorithm, std::string_view {"other config"}));
+        REQUIRE(other_cache.save(cache_path));
+
+        codegen_cache journal_cache;
+        REQUIRE(journal_cache.read(cache_path));
+        REQUIRE(journal_cache.find_fingerprint("stage") == other_cache.find_fingerprint("stage"));
+    }
+
+    SECTION("drop torn journal records")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+        const std::string cache_path = (directory / ".codegen.cache").string();
+        REQUIRE(files::write_file(other_path, std::string {"other content"}));
+
+        REQUIRE(cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(cache.save(cache_path));
+
+        {
+            std::ofstream stream(cache_path + ".journal", std::ios::out | std::ios::binary | std::ios::app);
+            stream << "torn";
+        }
+
+        codegen_cache other_cache;
+        REQUIRE(other_cache.read(cache_path));
+        REQUIRE(other_cache.find(path).has_value());
+        REQUIRE(other_cache.check_and_update(other_path) == codegen_cache_status::new_);
+        REQUIRE(other_cache.save(cache_path));
+
+        codegen_cache journal_cache;
+        REQUIRE(journal_cache.read(cache_path));
+        REQUIRE(journal_cache.find(path).has_value());
+        REQUIRE(journal_cache.find(other_path).has_value());
+    }
+
+    SECTION("merge entries of runs sharing the cache file")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+        REQUIRE(files::write_file(other_path, std::string {"other content"}));
+
+        for (const std::string_view extension : {".cache", ".json"})
+        {
+            const std::string cache_path = (directory / "shared").replace_extension(extension).string();
+            REQUIRE(codegen_cache {}.write(cache_path));
+
+            codegen_cache first_cache;
+            codegen_cache second_cache;
+            REQUIRE(first_cache.read(cache_path));
+            REQUIRE(second_cache.read(cache_path));
+
+            REQUIRE(first_cache.check_and_update(path) == codegen_cache_status::new_);
+            first_cache.update_fingerprint("first", hashes::hash(cache.algorithm, std::string_view {"first config"}));
+            REQUIRE(first_cache.save(cache_path));
+
+            REQUIRE(second_cache.check_and_update(other_path) == codegen_cache_status::new_);
+            second_cache.update_fingerprint("second", hashes::hash(cache.algorithm, std::string_view {"second config"}));
+            REQUIRE(second_cache.save(cache_path));
+
+            codegen_cache shared_cache;
+            REQUIRE(shared_cache.read(cache_path));
+            REQUIRE(shared_cache.find(path).has_value());
+            REQUIRE(shared_cache.find(other_path).has_value());
+            REQUIRE(shared_cache.find_fingerprint("first").has_value());
+            REQUIRE(shared_cache.find_fingerprint("second").has_value());
+
+            REQUIRE(first_cache.write(cache_path));
+            REQUIRE(shared_cache.read(cache_path));
+            REQUIRE(shared_cache.find(other_path).has_value());
+            REQUIRE(shared_cache.find_fingerprint("second").has_value());
+        }
+    }
+
+    SECTION("append to the journal of runs sharing the cache file")
+    {
+        const std::string other_path = (directory / "other.txt").string();
+        const std::string cache_path = (directory / ".codegen.cache").string();
+        REQUIRE(files::write_file(other_path, std::string {"other content"}));
+        REQUIRE(codegen_cache {}.write(cache_path));
+
+        codegen_cache first_cache;
+        codegen_cache second_cache;
+        REQUIRE(first_cache.read(cache_path));
+        REQUIRE(second_cache.read(cache_path));
+
+        REQUIRE(first_cache.check_and_update(path) == codegen_cache_status::new_);
+        REQUIRE(first_cache.flush(cache_path, [](const std::string&) { return true; }));
+        REQUIRE(second_cache.check_and_update(other_path) == codegen_cache_status::new_);
+        REQUIRE(second_cache.flush(cache_path, [](const std::string&) { return true; }));
+        REQUIRE(first_cache.update_dependencies(path, {other_path}));
+        REQUIRE(first_cache.flush(cache_path, [](const std::string&) { return true; }));
+
+        codegen_cache journal_cache;
+        REQUIRE(journal_cache.read(cache_path));
+        REQUIRE(journal_cache.find(path)->dependencies == std::vector {other_path});
+        REQUIRE(journal_cache.find(other_path).has_value());
+    }
+
+    SECTION("ignore invalid binary cache files")
+    {
+        const std::string cache_path = (directory / ".codegen.cache").string();
+        REQUIRE(files::write_file(cache_path, std::string {"not a cache"}));
+        REQUIRE_FALSE(cache.read(cache_path));
+    }
+
+    std::filesystem::remove_all(directory);
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "catch2/catch_all.hpp"
+
+#include "spore/codegen/codegen_config.hpp"
+
+TEST_CASE("spore::codegen::codegen_config", "[spore::codegen][spore::codegen::codegen_config]")
+{
+    using namespace spore::codegen;
+
+    const auto make_stage = [](const std::string_view name) {
+        return nlohmann::json {
+            {"name", name},
+            {"directory", "include"},
+            {"parser", "cpp"},
+            {"files", "**/*.hpp"},
+            {"steps", nlohmann::json::array()},
+        };
+    };
+
+    SECTION("read stages")
+    {
+        const nlohmann::json json {
+            {"version", 1},
+            {"stages", {make_stage("first"), make_stage("second")}},
+        };
+
+        const codegen_config config = json;
+        REQUIRE(config.stages.size() == 2);
+        REQUIRE(config.stages.at(0).name == "first");
+        REQUIRE(config.stages.at(0).files == std::vector<std::string> {"**/*.hpp"});
+        REQUIRE(config.stages.at(1).name == "second");
+    }
+
+    SECTION("reject duplicate stage names")
+    {
+        const nlohmann::json json {
+            {"version", 1},
+            {"stages", {make_stage("stage"), make_stage("stage")}},
+        };
+
+        codegen_config config;
+        REQUIRE_THROWS_AS(json.get_to(config), codegen_error);
+    }
+}
\ No newline at end of file
@@ -1,9 +1,14 @@
+#include <cstddef>
 #include <filesystem>
+#include <format>
 #include <source_location>
+#include <string>
+#include <vector>
 
 #include "catch2/catch_all.hpp"
 
 #include "spore/codegen/parsers/cpp/codegen_parser_cpp.hpp"
+#include "spore/codegen/utils/files.hpp"
 
 namespace spore::codegen::detail
 {
@@ -583,4 +588,163 @@ TEST_CASE("spore::codegen::codegen_parser_cpp", "[spore::codegen][spore::codegen
         REQUIRE(var11.type.extent.at(1) == 2);
         REQUIRE(var11.type.extent.at(2) == 2);
     }
+}
+
+TEST_CASE("spore::codegen::codegen_parser_cpp dependencies", "[spore::codegen][spore::codegen::codegen_parser_cpp]")
+{
+    using namespace spore::codegen;
+
+    constexpr std::string_view parser_args[] {"-std=c++20"};
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "spore-codegen-t-codegen-parser-cpp";
+    const auto make_path = [&](const std::string_view name) { return std::filesystem::weakly_canonical(directory / name).string(); };
+
+    std::filesystem::remove_all(directory);
+    REQUIRE(files::write_file(make_path("a.hpp"), std::string {"#include \"b.hpp\"\nstruct a {};"}));
+    REQUIRE(files::write_file(make_path("b.hpp"), std::string {"#include \"c.hpp\"\nstruct b {};"}));
+    REQUIRE(files::write_file(make_path("c.hpp"), std::string {"#pragma once\nstruct c {};"}));
+    REQUIRE(files::write_file(make_path("d.hpp"), std::string {"#include \"c.hpp\"\nstruct d {};"}));
+
+    codegen_parser_cpp parser {parser_args};
+    std::vector input_files {make_path("a.hpp"), make_path("d.hpp")};
+    std::vector<std::vector<std::string>> dependencies(input_files.size());
+
+    const auto callback = [](cpp_file&&) {};
+    const auto dependencies_callback = [&](const std::size_t path_index, std::vector<std::string>&& path_dependencies) {
+        dependencies.at(path_index) = std::move(path_dependencies);
+    };
+
+    REQUIRE(parser.parse_asts(input_files, callback, dependencies_callback));
+
+    SECTION("record transitive includes")
+    {
+        REQUIRE(dependencies.at(0) == std::vector {make_path("b.hpp"), make_path("c.hpp")});
+    }
+
+    SECTION("record includes skipped by include guards")
+    {
+        REQUIRE(dependencies.at(1) == std::vector {make_path("c.hpp")});
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("spore::codegen::codegen_parser_cpp translation units", "[spore::codegen][spore::codegen::codegen_parser_cpp]")
+{
+    using namespace spore::codegen;
+
+    constexpr std::string_view parser_args[] {"-std=c++20"};
+    constexpr std::size_t file_count = 32;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "spore-codegen-t-codegen-parser-cpp-units";
+    const auto make_path = [&](const std::string_view name) { return std::filesystem::weakly_canonical(directory / name).string(); };
+
+    std::filesystem::remove_all(directory);
+    REQUIRE(files::write_file(make_path("common.hpp"), std::string {"#pragma once\nstruct common {};"}));
+
+    std::vector<std::string> input_files;
+
+    for (std::size_t index = 0; index < file_count; ++index)
+    {
+        const std::string path = make_path(std::format("file{}.hpp", index));
+        REQUIRE(files::write_file(path, std::format("#include \"common.hpp\"\nstruct struct{} {{}};", index)));
+        input_files.emplace_back(path);
+    }
+
+    const auto parse = [&](codegen_parser_cpp& parser, std::vector<cpp_file>& cpp_files, std::vector<std::vector<std::string>>& dependencies) {
+        dependencies.resize(input_files.size());
+
+        const auto callback = [&](cpp_file&& cpp_file) { cpp_files.emplace_back(std::move(cpp_file)); };
+        const auto dependencies_callback = [&](const std::size_t path_index, std::vector<std::string>&& path_dependencies) {
+            dependencies.at(path_index) = std::move(path_dependencies);
+        };
+
+        return parser.parse_asts(input_files, callback, dependencies_callback);
+    };
+
+    codegen_parser_cpp single_parser {parser_args};
+    std::vector<cpp_file> single_cpp_files;
+    std::vector<std::vector<std::string>> single_dependencies;
+    REQUIRE(parse(single_parser, single_cpp_files, single_dependencies));
+
+    codegen_parser_cpp parallel_parser {parser_args, 4};
+    std::vector<cpp_file> parallel_cpp_files;
+    std::vector<std::vector<std::string>> parallel_dependencies;
+    REQUIRE(parse(parallel_parser, parallel_cpp_files, parallel_dependencies));
+
+    SECTION("hand files in the order of the paths")
+    {
+        REQUIRE(parallel_cpp_files.size() == file_count);
+
+        for (std::size_t index = 0; index < file_count; ++index)
+        {
+            REQUIRE(parallel_cpp_files.at(index).path == single_cpp_files.at(index).path);
+            REQUIRE(parallel_cpp_files.at(index).classes.size() == 1);
+            REQUIRE(parallel_cpp_files.at(index).classes.at(0).name == std::format("struct{}", index));
+        }
+    }
+
+    SECTION("record includes of every unit")
+    {
+        REQUIRE(parallel_dependencies == single_dependencies);
+        REQUIRE(parallel_dependencies.back() == std::vector {make_path("common.hpp")});
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("spore::codegen::codegen_parser_cpp preamble", "[spore::codegen][spore::codegen::codegen_parser_cpp]")
+{
+    using namespace spore::codegen;
+
+    constexpr std::string_view parser_args[] {"-std=c++20"};
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "spore-codegen-t-codegen-parser-cpp-preamble";
+    const std::string input_file = std::filesystem::weakly_canonical(directory / "file.hpp").string();
+    const std::string preamble_path = std::filesystem::weakly_canonical(directory / ".codegen.cache").string();
+
+    std::filesystem::remove_all(directory);
+    REQUIRE(files::write_file(input_file, std::string {"#include <vector>\nstruct with_vector { std::vector<int> values; };"}));
+
+    const auto parse = [&](codegen_parser_cpp& parser, std::vector<cpp_file>& cpp_files) {
+        const auto callback = [&](cpp_file&& cpp_file) { cpp_files.emplace_back(std::move(cpp_file)); };
+        return parser.parse_asts(std::vector {input_file}, callback, [](std::size_t, std::vector<std::string>&&) {});
+    };
+
+    codegen_parser_cpp parser {parser_args};
+    std::vector<cpp_file> cpp_files;
+    REQUIRE(parse(parser, cpp_files));
+
+    codegen_parser_cpp preamble_parser {parser_args, 1, {"vector"}, preamble_path};
+    std::vector<cpp_file> preamble_cpp_files;
+    REQUIRE(parse(preamble_parser, preamble_cpp_files));
+
+    SECTION("parse files the same as without preamble")
+    {
+        REQUIRE(preamble_cpp_files.size() == 1);
+        REQUIRE(preamble_cpp_files.at(0).classes.size() == cpp_files.at(0).classes.size());
+        REQUIRE(preamble_cpp_files.at(0).classes.at(0).name == "with_vector");
+        REQUIRE(preamble_cpp_files.at(0).classes.at(0).fields.at(0).type.name == cpp_files.at(0).classes.at(0).fields.at(0).type.name);
+    }
+
+    SECTION("fingerprint the preamble")
+    {
+        const codegen_parser_cpp other_preamble_parser {parser_args, 1, {"vector"}, preamble_path};
+        REQUIRE(preamble_parser.fingerprint() != parser.fingerprint());
+        REQUIRE(other_preamble_parser.fingerprint() == preamble_parser.fingerprint());
+    }
+
+    SECTION("fingerprint the preamble without precompiling it")
+    {
+        const std::string other_preamble_path = std::filesystem::weakly_canonical(directory / ".other.cache").string();
+        const codegen_parser_cpp other_preamble_parser {parser_args, 1, {"vector"}, other_preamble_path};
+        REQUIRE(!other_preamble_parser.fingerprint().empty());
+
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+        {
+            REQUIRE(!entry.path().filename().string().starts_with(".other.cache"));
+        }
+    }
+
+    std::filesystem::remove_all(directory);
 }
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include <filesystem>
+#include <format>
+#include <string>
+
+#include "catch2/catch_all.hpp"
+
+#include "spore/codegen/codegen_error.hpp"
+#include "spore/codegen/misc/file_writer.hpp"
+
+TEST_CASE("spore::codegen::file_writer", "[spore::codegen][spore::codegen::file_writer]")
+{
+    using namespace spore::codegen;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "spore-codegen-t-file-writer";
+
+    std::filesystem::remove_all(directory);
+
+    file_writer writer {4};
+
+    SECTION("write every file before wait returns")
+    {
+        file_writer::group group {writer};
+
+        for (std::size_t index = 0; index < 32; ++index)
+        {
+            group.write((directory / std::to_string(index / 8) / std::format("{}.txt", index)).string(), std::to_string(index));
+        }
+
+        group.wait();
+
+        for (std::size_t index = 0; index < 32; ++index)
+        {
+            std::string content;
+            REQUIRE(files::read_file((directory / std::to_string(index / 8) / std::format("{}.txt", index)).string(), content));
+            REQUIRE(content == std::to_string(index));
+        }
+    }
+
+    SECTION("report failures to the group that wrote them")
+    {
+        std::filesystem::create_directories(directory / "file.txt" / "directory");
+
+        file_writer::group failed_group {writer};
+        file_writer::group group {writer};
+
+        failed_group.write((directory / "file.txt").string(), "content");
+        group.write((directory / "other.txt").string(), "content");
+
+        REQUIRE_THROWS_AS(failed_group.wait(), codegen_error);
+        REQUIRE_NOTHROW(group.wait());
+    }
+
+    std::filesystem::remove_all(directory);
+}
\ No newline at end of file
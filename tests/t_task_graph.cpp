@@ -0,0 +1,66 @@
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "spore/codegen/codegen_error.hpp"
+#include "spore/codegen/misc/task_graph.hpp"
+
+TEST_CASE("spore::codegen::task_graph", "[spore::codegen][spore::codegen::task_graph]")
+{
+    using namespace spore::codegen;
+
+    thread_pool pool {4};
+
+    SECTION("run tasks after their dependencies")
+    {
+        std::mutex mutex;
+        std::vector<std::size_t> order;
+
+        task_graph graph;
+
+        for (std::size_t index = 0; index < 4; ++index)
+        {
+            graph.add_task([&, index] {
+                std::scoped_lock lock {mutex};
+                order.emplace_back(index);
+            });
+        }
+
+        graph.add_dependency(3, 2);
+        graph.add_dependency(2, 0);
+        graph.add_dependency(2, 1);
+
+        graph.run(pool);
+
+        REQUIRE(order.size() == 4);
+        REQUIRE(order.at(2) == 2);
+        REQUIRE(order.at(3) == 3);
+    }
+
+    SECTION("skip dependents of failed tasks")
+    {
+        std::atomic<bool> dependent_run = false;
+
+        task_graph graph;
+        graph.add_task([] { throw std::runtime_error("failure"); });
+        graph.add_task([&] { dependent_run = true; });
+        graph.add_dependency(1, 0);
+
+        REQUIRE_THROWS_AS(graph.run(pool), std::runtime_error);
+        REQUIRE_FALSE(dependent_run);
+    }
+
+    SECTION("reject cyclic dependencies")
+    {
+        task_graph graph;
+        graph.add_task([] {});
+        graph.add_task([] {});
+        graph.add_dependency(0, 1);
+        graph.add_dependency(1, 0);
+
+        REQUIRE_THROWS_AS(graph.run(pool), codegen_error);
+    }
+}
\ No newline at end of file
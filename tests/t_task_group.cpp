@@ -0,0 +1,67 @@
+#include <atomic>
+#include <stdexcept>
+
+#include "catch2/catch_all.hpp"
+
+#include "spore/codegen/misc/task_group.hpp"
+
+TEST_CASE("spore::codegen::task_group", "[spore::codegen][spore::codegen::task_group]")
+{
+    using namespace spore::codegen;
+
+    SECTION("run every task before wait returns")
+    {
+        for (const std::size_t thread_count : {1, 4})
+        {
+            thread_pool pool {thread_count};
+            std::atomic<std::size_t> count = 0;
+
+            task_group group {pool};
+
+            for (std::size_t index = 0; index < 100; ++index)
+            {
+                group.run([&] { ++count; });
+            }
+
+            group.wait();
+
+            REQUIRE(count == 100);
+        }
+    }
+
+    SECTION("run nested groups without exhausting workers")
+    {
+        thread_pool pool {2};
+        std::atomic<std::size_t> count = 0;
+
+        task_group group {pool};
+
+        for (std::size_t index = 0; index < 4; ++index)
+        {
+            group.run([&] {
+                task_group nested_group {pool};
+
+                for (std::size_t nested_index = 0; nested_index < 4; ++nested_index)
+                {
+                    nested_group.run([&] { ++count; });
+                }
+
+                nested_group.wait();
+            });
+        }
+
+        group.wait();
+
+        REQUIRE(count == 16);
+    }
+
+    SECTION("rethrow the first exception")
+    {
+        thread_pool pool {4};
+
+        task_group group {pool};
+        group.run([] { throw std::runtime_error("failure"); });
+
+        REQUIRE_THROWS_AS(group.wait(), std::runtime_error);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include "catch2/catch_all.hpp"
+
+#include "spore/codegen/misc/thread_pool.hpp"
+
+TEST_CASE("spore::codegen::thread_pool", "[spore::codegen][spore::codegen::thread_pool]")
+{
+    using namespace spore::codegen;
+
+    thread_pool pool {4};
+
+    REQUIRE(pool.size() == 4);
+
+    SECTION("parallel for runs every index once")
+    {
+        std::vector<std::atomic<std::size_t>> counts(1000);
+
+        pool.parallel_for(counts.size(), [&](const std::size_t index) {
+            ++counts.at(index);
+        });
+
+        for (const std::atomic<std::size_t>& count : counts)
+        {
+            REQUIRE(count == 1);
+        }
+    }
+
+    SECTION("parallel for runs nested calls")
+    {
+        std::atomic<std::size_t> count = 0;
+
+        pool.parallel_for(16, [&](std::size_t) {
+            pool.parallel_for(16, [&](std::size_t) { ++count; });
+        });
+
+        REQUIRE(count == 16 * 16);
+    }
+
+    SECTION("parallel for rethrows after all indices are completed")
+    {
+        std::atomic<std::size_t> count = 0;
+
+        const auto action = [&] {
+            pool.parallel_for(100, [&](const std::size_t index) {
+                ++count;
+
+                if (index == 42)
+                {
+                    throw std::runtime_error("failure");
+                }
+            });
+        };
+
+        REQUIRE_THROWS_AS(action(), std::runtime_error);
+        REQUIRE(count == 100);
+    }
+
+    SECTION("calling thread is slot 0")
+    {
+        REQUIRE(thread_pool::current_slot() == 0);
+    }
+}
\ No newline at end of file
@@ -1,5 +1,18 @@
+#include <cstdint>
+#include <filesystem>
+#include <source_location>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
 #include "catch2/catch_all.hpp"
 
+#include "spore/codegen/misc/make_unique_id.hpp"
+#include "spore/codegen/misc/mapped_file.hpp"
+#include "spore/codegen/parsers/cpp/codegen_converter_cpp.hpp"
+#include "spore/codegen/utils/files.hpp"
+#include "spore/codegen/utils/hashes.hpp"
 #include "spore/codegen/utils/strings.hpp"
 
 TEST_CASE("spore::codegen::strings", "[spore::codegen][spore::codegen::strings]")
@@ -54,6 +67,16 @@ TEST_CASE("spore::codegen::strings", "[spore::codegen][spore::codegen::strings]"
         CHECK(mixed_case0_expected == strings::split_into_words(MIXED_CASE0));
     }
 
+    SECTION("contains any value")
+    {
+        const std::vector<std::string> values {"CLASS(", "clang::annotate"};
+
+        REQUIRE(strings::contains_any("struct CLASS() value {};", values));
+        REQUIRE(strings::contains_any("struct [[clang::annotate(\"json\")]] value {};", values));
+        REQUIRE_FALSE(strings::contains_any("struct CLASS value {};", values));
+        REQUIRE_FALSE(strings::contains_any("struct value {};", std::vector<std::string> {}));
+    }
+
     SECTION("to case")
     {
         struct test_case
@@ -106,3 +129,220 @@ TEST_CASE("spore::codegen::strings", "[spore::codegen][spore::codegen::strings]"
         }
     }
 }
+
+TEST_CASE("spore::codegen::files", "[spore::codegen][spore::codegen::files]")
+{
+    using namespace spore::codegen;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "spore-codegen-t-utils";
+    const std::string path = (directory / "file.txt").string();
+
+    std::filesystem::remove_all(directory);
+
+    SECTION("write file only if changed")
+    {
+        bool changed;
+
+        REQUIRE(files::write_file_if_changed(path, "content", changed));
+        REQUIRE(changed);
+
+        const std::filesystem::file_time_type write_time = std::filesystem::last_write_time(path);
+
+        REQUIRE(files::write_file_if_changed(path, "content", changed));
+        REQUIRE_FALSE(changed);
+        REQUIRE(std::filesystem::last_write_time(path) == write_time);
+
+        REQUIRE(files::write_file_if_changed(path, "other content", changed));
+        REQUIRE(changed);
+
+        std::string content;
+        REQUIRE(files::read_file(path, content));
+        REQUIRE(content == "other content");
+    }
+
+    SECTION("write file only if changed with newlines")
+    {
+        const std::string content = "first line\nsecond line\r\n";
+        bool changed;
+
+        REQUIRE(files::write_file_if_changed(path, content, changed));
+        REQUIRE(changed);
+
+        const std::filesystem::file_time_type write_time = std::filesystem::last_write_time(path);
+
+        REQUIRE(files::write_file_if_changed(path, content, changed));
+        REQUIRE_FALSE(changed);
+        REQUIRE(std::filesystem::last_write_time(path) == write_time);
+
+        std::vector<std::uint8_t> bytes;
+        REQUIRE(files::read_file(path, bytes));
+        REQUIRE(std::string(bytes.begin(), bytes.end()) == content);
+    }
+
+    SECTION("write file without leaving temporary files")
+    {
+        REQUIRE(files::write_file(path, std::string {"content"}));
+        REQUIRE(std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()) == 1);
+    }
+
+    SECTION("read mapped file")
+    {
+        // Small files are read into a buffer and large files are mapped, both must give the same view.
+        for (const std::size_t size : {std::size_t {0}, std::size_t {16}, std::size_t {1024 * 1024}})
+        {
+            const std::string content(size, 'x');
+            REQUIRE(files::write_file(path, content));
+
+            mapped_file file;
+            REQUIRE(file.open(path));
+            REQUIRE(file.size() == size);
+            REQUIRE(file.text() == content);
+
+            std::vector<std::uint8_t> bytes;
+            REQUIRE(files::read_file(path, bytes));
+            REQUIRE(bytes.size() == size);
+        }
+
+        mapped_file file;
+        REQUIRE_FALSE(file.open(directory / "missing.txt"));
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("spore::codegen::hashes", "[spore::codegen][spore::codegen::hashes]")
+{
+    using namespace spore::codegen;
+
+    const std::string input = "abc";
+    const std::span<const std::uint8_t> data {reinterpret_cast<const std::uint8_t*>(input.data()), input.size()};
+
+    SECTION("hash data")
+    {
+        REQUIRE(hashes::to_hex(hashes::hash(hashes::hash_algorithm::xxh3, data)) == "06b05ab6733a618578af5f94892f3950");
+        REQUIRE(hashes::to_hex(hashes::hash(hashes::hash_algorithm::sha256, data)) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    }
+
+    SECTION("convert digest from and to hex")
+    {
+        const std::string digest = hashes::hash(hashes::hash_algorithm::xxh3, data);
+
+        std::string other_digest;
+        REQUIRE(hashes::from_hex(hashes::to_hex(digest), other_digest));
+        REQUIRE(other_digest == digest);
+
+        REQUIRE_FALSE(hashes::from_hex("0", other_digest));
+        REQUIRE_FALSE(hashes::from_hex("0g", other_digest));
+    }
+
+    SECTION("convert algorithm from and to string")
+    {
+        for (const hashes::hash_algorithm algorithm : {hashes::hash_algorithm::xxh3, hashes::hash_algorithm::sha256})
+        {
+            REQUIRE(hashes::from_string(hashes::to_string(algorithm)) == algorithm);
+        }
+
+        REQUIRE_FALSE(hashes::from_string("md5").has_value());
+    }
+}
+
+TEST_CASE("spore::codegen::make_unique_id", "[spore::codegen][spore::codegen::make_unique_id]")
+{
+    using namespace spore::codegen;
+
+    const auto make_ids = [] {
+        unique_id_scope id_scope;
+        return std::vector {make_unique_id<int>(), make_unique_id<float>(), make_unique_id<int>()};
+    };
+
+    SECTION("make the same ids in every scope")
+    {
+        const std::vector<std::size_t> ids = make_ids();
+        std::ignore = make_unique_id<int>();
+
+        REQUIRE(make_ids() == ids);
+    }
+
+    SECTION("count ids per type from the start of the scope")
+    {
+        REQUIRE(make_ids() == std::vector<std::size_t> {1, 1, 2});
+    }
+
+    SECTION("make different ids for converted files of different indices")
+    {
+        const auto convert = [](const std::size_t index, const std::string& path) {
+            cpp_file file {.path = path, .classes = {cpp_class {}}};
+            unique_id_scope id_scope {index};
+
+            nlohmann::json json;
+            REQUIRE(codegen_converter_cpp {}.convert_ast(file, json));
+            return json;
+        };
+
+        const nlohmann::json json = convert(0, "a.hpp");
+        const nlohmann::json other_json = convert(1, "b.hpp");
+
+        REQUIRE(json["id"] != other_json["id"]);
+        REQUIRE(json["classes"][0]["id"] != other_json["classes"][0]["id"]);
+        REQUIRE(convert(1, "b.hpp") == other_json);
+    }
+}
+
+TEST_CASE("spore::codegen::hashes benchmark", "[.benchmark][spore::codegen::hashes]")
+{
+    using namespace spore::codegen;
+
+    constexpr std::source_location source_location = std::source_location::current();
+    const std::filesystem::path current_dir = std::filesystem::path(source_location.file_name()).parent_path();
+
+    // Headers of this repository and the SPIR-V module of the parser tests, repeated to get a corpus large enough
+    // to measure throughput rather than call overhead.
+    const auto make_corpus = [](const std::vector<std::filesystem::path>& paths, const std::size_t min_size) {
+        std::vector<std::uint8_t> corpus;
+
+        while (corpus.size() < min_size)
+        {
+            for (const std::filesystem::path& path : paths)
+            {
+                std::vector<std::uint8_t> bytes;
+                REQUIRE(files::read_file(path.string(), bytes));
+                corpus.insert(corpus.end(), bytes.begin(), bytes.end());
+            }
+        }
+
+        return corpus;
+    };
+
+    std::vector<std::filesystem::path> header_paths;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(current_dir.parent_path() / "include"))
+    {
+        if (entry.path().extension() == ".hpp")
+        {
+            header_paths.emplace_back(entry.path());
+        }
+    }
+
+    constexpr std::size_t corpus_size = 16 * 1024 * 1024;
+    const std::vector<std::uint8_t> header_corpus = make_corpus(header_paths, corpus_size);
+    const std::vector<std::uint8_t> spirv_corpus = make_corpus({current_dir / "t_codegen_parser_spirv_data.spv"}, corpus_size);
+
+    BENCHMARK("xxh3 headers")
+    {
+        return hashes::hash(hashes::hash_algorithm::xxh3, header_corpus);
+    };
+
+    BENCHMARK("sha256 headers")
+    {
+        return hashes::hash(hashes::hash_algorithm::sha256, header_corpus);
+    };
+
+    BENCHMARK("xxh3 spirv")
+    {
+        return hashes::hash(hashes::hash_algorithm::xxh3, spirv_corpus);
+    };
+
+    BENCHMARK("sha256 spirv")
+    {
+        return hashes::hash(hashes::hash_algorithm::sha256, spirv_corpus);
+    };
+}
\ No newline at end of file